@@ -0,0 +1,73 @@
+#include "adapt.h"
+#include "genetic.h"
+#include <math.h>
+
+#define TARGET      0.1         // success rate the mutation rate steers to
+#define RATE_UP     1.2
+#define RATE_MIN    1
+#define RATE_MAX    0x3FFFF     // a quarter of the 0xFFFFF scale
+#define K_MIN       2
+#define DISCOUNT    0.9         // weight of a window's reward after each further window
+#define EXPLORE     0.1         // UCB1 exploration constant, success rates are small
+
+void adapt_init(adapt_t *ad, int mutation_per_Mi, int k, int arms, int arm)
+{
+    *ad = (adapt_t) { .mutation_per_Mi = mutation_per_Mi, .k = k, .k_max = k, .arm = arm, .rate = mutation_per_Mi };
+    ad->arms = arms < ADAPT_MAX_ARMS ? arms : ADAPT_MAX_ARMS;
+}
+
+void adapt_update(adapt_t *ad, unsigned long offspring, unsigned long improved, int64_t best, int criteria)
+{
+    unsigned long n = offspring - ad->offspring;
+    unsigned long s = improved - ad->improved;
+    ad->offspring = offspring;
+    ad->improved = improved;
+    if (!n)
+        return;
+
+    double ps = (double) s / n;
+    ad->success = ps;
+
+    // Success rule, with one step up undone by (1 - TARGET) / TARGET steps down
+    ad->rate = ps < TARGET ? ad->rate * RATE_UP : ad->rate / pow(RATE_UP, TARGET / (1 - TARGET));
+    ad->rate = fmin(fmax(ad->rate, RATE_MIN), RATE_MAX);
+    ad->mutation_per_Mi = (int) ad->rate;
+
+    // Selection pressure
+    int improving = !ad->decisions || (criteria == GA_MINIMIZE ? best < ad->best : best > ad->best);
+    ad->best = best;
+    ad->k += improving ? 1 : -1;
+    ad->k = ad->k < K_MIN ? K_MIN : ad->k > ad->k_max ? ad->k_max : ad->k;
+
+    // Operator choice
+    double total = 0;
+    for (int a = 0; a < ad->arms; a++)
+    {
+        ad->reward[a] *= DISCOUNT;
+        ad->pulls[a] *= DISCOUNT;
+    }
+    ad->reward[ad->arm] += ps;
+    ad->pulls[ad->arm] += 1;
+    for (int a = 0; a < ad->arms; a++)
+        total += ad->pulls[a];
+
+    int choice = ad->arm;
+    double score = -INFINITY;
+    for (int a = 0; a < ad->arms; a++)
+    {
+        // Operators not tried recently go first
+        if (ad->pulls[a] < 1e-3)
+        {
+            choice = a;
+            break;
+        }
+        double sc = ad->reward[a] / ad->pulls[a] + EXPLORE * sqrt(log(total) / ad->pulls[a]);
+        if (sc > score)
+        {
+            score = sc;
+            choice = a;
+        }
+    }
+    ad->arm = choice;
+    ad->decisions++;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Online control of an island's mutation rate, tournament size and mutation operator
+
+    The island is observed over windows of generations. An offspring is a success if it is fitter
+    than the parent it took its first half from.
+    - Mutation rate follows a success rule in the style of the 1/5th rule, steering to a tenth.
+      Unlike an evolution strategy's step size, a low success rate here means the population is
+      converging, so the rate grows below the target and shrinks above it.
+    - Tournament size shrinks while the best solution stalls, trading selection pressure for
+      exploration, and grows back up to its initial value while it improves.
+    - The mutation operator is chosen by a discounted UCB1 bandit rewarded with the success rate
+      of the windows it was used in.
+*/
+
+#define ADAPT_MAX_ARMS 4
+
+typedef struct {
+    /* Parameters in use */
+    int mutation_per_Mi;
+    int k, k_max;
+    int arm;                        // mutation operator
+
+    /* Controller state */
+    double rate;                    // mutation rate before rounding
+    int arms;
+    double reward[ADAPT_MAX_ARMS];  // discounted sum of success rates
+    double pulls[ADAPT_MAX_ARMS];   // discounted number of windows
+    unsigned long offspring, improved;  // engine counters at the start of the window
+    int64_t best;                   // best fitness at the start of the window
+    double success;                 // success rate of the last window
+    unsigned long decisions;
+} adapt_t;
+
+void adapt_init(adapt_t *ad, int mutation_per_Mi, int k, int arms, int arm);
+
+// Closes a window. offspring and improved are the engine's running totals, best the island's
+// current best fitness
+void adapt_update(adapt_t *ad, unsigned long offspring, unsigned long improved, int64_t best, int criteria);
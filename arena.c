@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+#include "arena.h"
+#include <sched.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+// get_mempolicy flags, from <numaif.h> which is not always installed
+#define MPOL_F_NODE (1 << 0)
+#define MPOL_F_ADDR (1 << 1)
+
+void *arena_map(arena_t *arena, size_t size)
+{
+    *arena = (arena_t) {0};
+    if (!size)
+        return NULL;
+
+    size_t huge_size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void *p = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+    {
+        *arena = (arena_t) { .base = p, .size = huge_size, .pages = ARENA_PAGES_HUGE };
+        return p;
+    }
+
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    *arena = (arena_t) { .base = p, .size = size, .pages = ARENA_PAGES_SMALL };
+    #ifdef MADV_HUGEPAGE
+    if (size >= HUGE_PAGE_SIZE && !madvise(p, size, MADV_HUGEPAGE))
+        arena->pages = ARENA_PAGES_THP;
+    #endif
+    return p;
+}
+
+void arena_unmap(arena_t *arena)
+{
+    if (arena->base)
+        munmap(arena->base, arena->size);
+    *arena = (arena_t) {0};
+}
+
+int arena_touch(void *p, size_t size, int cpu)
+{
+    cpu_set_t old;
+    int moved = !sched_getaffinity(0, sizeof(old), &old) && arena_pin(cpu);
+
+    long page = sysconf(_SC_PAGESIZE);
+    volatile char *c = (volatile char *) p;
+    // One write per page keeps the contents. A page shared with the previous island's part
+    // stays on the node where it was first touched
+    for (size_t off = 0; off < size; off += page - ((uintptr_t) (c + off) % page))
+        c[off] = c[off];
+    if (size)
+        c[size - 1] = c[size - 1];
+
+    if (moved)
+        sched_setaffinity(0, sizeof(old), &old);
+    return moved;
+}
+
+int arena_island_cpu(int i, int n)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set))
+        return -1;
+
+    int count = CPU_COUNT(&set);
+    int target = (long) i * count / (n > 0 ? n : 1);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &set) && target-- == 0)
+            return cpu;
+    return -1;
+}
+
+int arena_pin(int cpu)
+{
+    if (cpu < 0)
+        return 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return !sched_setaffinity(0, sizeof(set), &set);
+}
+
+int arena_node(const void *p)
+{
+    #ifdef SYS_get_mempolicy
+    int node = -1;
+    if (!syscall(SYS_get_mempolicy, &node, NULL, 0, p, MPOL_F_NODE | MPOL_F_ADDR))
+        return node;
+    #endif
+    return -1;
+}
+
+const char *arena_pages_name(int pages)
+{
+    switch (pages)
+    {
+        case ARENA_PAGES_HUGE:
+            return "huge";
+        case ARENA_PAGES_THP:
+            return "transparent huge";
+        default:
+            return "small";
+    }
+}
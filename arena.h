@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+    Placement of island memory on NUMA machines
+
+    Memory is mapped without being touched, then each island's part is touched from the core
+    its thread will be pinned to. Linux places a page on the node of the first thread touching
+    it, so every island's solutions end up in memory local to the core evolving them.
+*/
+
+#define ARENA_PAGES_SMALL 0
+#define ARENA_PAGES_HUGE  1     // explicit huge pages (hugetlbfs pool)
+#define ARENA_PAGES_THP   2     // transparent huge pages requested
+
+typedef struct {
+    void *base;
+    size_t size;
+    int pages;
+} arena_t;
+
+// Maps size bytes, backed by huge pages when the system has some reserved, otherwise asking for
+// transparent huge pages. Returns NULL on failure
+void *arena_map(arena_t *arena, size_t size);
+
+void arena_unmap(arena_t *arena);
+
+// Touches every page of [p, p + size) while running on cpu, then restores the calling thread's
+// affinity. Returns 0 if the thread could not be moved to cpu
+int arena_touch(void *p, size_t size, int cpu);
+
+// CPU for island i of n, spread evenly over the CPUs the process may run on. Must be called
+// before any thread is pinned
+int arena_island_cpu(int i, int n);
+
+// Pins the calling thread to cpu, returns 0 on failure
+int arena_pin(int cpu);
+
+// NUMA node holding the page at p, -1 if unknown
+int arena_node(const void *p);
+
+// Name of an ARENA_PAGES_* value
+const char *arena_pages_name(int pages);
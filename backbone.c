@@ -0,0 +1,230 @@
+#include "backbone.h"
+#include "tsp.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NONE UINT32_MAX
+#define INF INT64_MAX
+
+// A node with orientation o is entered at its first city and left at its last one, or the
+// other way around if o is 1
+static inline uint32_t enter(const backbone_t *bb, uint32_t v, int o)
+{
+    return o ? bb->last[v] : bb->first[v];
+}
+
+static inline uint32_t leave(const backbone_t *bb, uint32_t v, int o)
+{
+    return o ? bb->first[v] : bb->last[v];
+}
+
+// Shortest length of the connections between the nodes of tour, starting at position s with
+// orientation os. If back is not NULL it receives, for every later position i and orientation o,
+// the best orientation of the previous node, and *close the orientation of the last one
+static int64_t walk(const backbone_t *bb, const tsp_2d_t *tsp, const uint32_t *tour, size_t s, int os, uint8_t *back, int *close)
+{
+    size_t m = bb->nodes;
+    uint32_t prev = tour[s];
+    int64_t cost[2] = { os ? INF : 0, os ? 0 : INF };
+    for (size_t i = 1; i < m; i++)
+    {
+        uint32_t v = tour[(s + i) % m];
+        int64_t next[2] = { INF, INF };
+        for (int o = 0; o < (bb->first[v] == bb->last[v] ? 1 : 2); o++)
+            for (int p = 0; p < 2; p++)
+            {
+                if (cost[p] == INF)
+                    continue;
+                int64_t c = cost[p] + tsp_round_dist(tsp, leave(bb, prev, p), enter(bb, v, o));
+                if (c < next[o])
+                {
+                    next[o] = c;
+                    if (back)
+                        back[2 * i + o] = p;
+                }
+            }
+        cost[0] = next[0];
+        cost[1] = next[1];
+        prev = v;
+    }
+
+    int64_t best = INF;
+    if (close)
+        *close = 0;
+    for (int p = 0; p < 2; p++)
+    {
+        if (cost[p] == INF)
+            continue;
+        int64_t c = cost[p] + tsp_round_dist(tsp, leave(bb, prev, p), enter(bb, tour[s], os));
+        if (c < best)
+        {
+            best = c;
+            if (close)
+                *close = p;
+        }
+    }
+    return best;
+}
+
+// Position to start walking from: a single city if there is one, as its orientation doesn't
+// matter, and the orientation of that node giving the shortest tour
+static size_t anchor(const backbone_t *bb, const tsp_2d_t *tsp, const uint32_t *tour, int *os, int64_t *length)
+{
+    size_t s = 0;
+    while (s < bb->nodes && bb->first[tour[s]] != bb->last[tour[s]])
+        s++;
+    *os = 0;
+    if (s < bb->nodes)
+    {
+        *length = walk(bb, tsp, tour, s, 0, NULL, NULL);
+        return s;
+    }
+
+    int64_t l0 = walk(bb, tsp, tour, 0, 0, NULL, NULL), l1 = walk(bb, tsp, tour, 0, 1, NULL, NULL);
+    *os = l1 < l0;
+    *length = l1 < l0 ? l1 : l0;
+    return 0;
+}
+
+int64_t backbone_length(const backbone_t *bb, const tsp_2d_t *tsp, const uint32_t *tour)
+{
+    int os;
+    int64_t length;
+    anchor(bb, tsp, tour, &os, &length);
+    return bb->inner + length;
+}
+
+void backbone_expand(const backbone_t *bb, const tsp_2d_t *tsp, const uint32_t *tour, uint32_t *cities)
+{
+    size_t m = bb->nodes;
+    int os, close;
+    int64_t length;
+    size_t s = anchor(bb, tsp, tour, &os, &length);
+
+    uint8_t *back = (uint8_t *) malloc(sizeof(uint8_t) * 2 * m);
+    uint8_t *orient = (uint8_t *) malloc(sizeof(uint8_t) * m);
+    walk(bb, tsp, tour, s, os, back, &close);
+    orient[0] = os;
+    if (m > 1)
+        orient[m - 1] = close;
+    for (size_t i = m - 1; i > 1; i--)
+        orient[i - 1] = back[2 * i + orient[i]];
+
+    size_t c = 0;
+    for (size_t i = 0; i < m; i++)
+    {
+        uint32_t v = tour[(s + i) % m];
+        if (orient[i])
+            for (uint32_t j = bb->start[v + 1]; j > bb->start[v]; j--)
+                cities[c++] = bb->paths[j - 1];
+        else
+            for (uint32_t j = bb->start[v]; j < bb->start[v + 1]; j++)
+                cities[c++] = bb->paths[j];
+    }
+    free(orient);
+    free(back);
+}
+
+void backbone_compress(const backbone_t *bb, const uint32_t *cities, uint32_t *tour)
+{
+    uint8_t *seen = (uint8_t *) calloc(bb->nodes, sizeof(uint8_t));
+    size_t m = 0;
+    for (size_t i = 0; i < bb->dim; i++)
+    {
+        uint32_t v = bb->node_of[cities[i]];
+        if (!seen[v])
+        {
+            seen[v] = 1;
+            tour[m++] = v;
+        }
+    }
+    free(seen);
+}
+
+size_t backbone_fix(const backbone_t *bb, const tsp_2d_t *tsp, uint32_t *const *tours, int n, size_t min_nodes, backbone_t *next)
+{
+    size_t dim = tsp->dim;
+    if (n < 1 || dim < 3)
+        return 0;
+
+    // Neighbors of every city in each tour but the first, whose edges are the candidates
+    uint32_t *adj = (uint32_t *) malloc(sizeof(uint32_t) * 2 * dim);
+    uint32_t *shared = (uint32_t *) malloc(sizeof(uint32_t) * dim);
+    for (size_t i = 0; i < dim; i++)
+        shared[i] = 1;
+    for (int t = 1; t < n; t++)
+    {
+        for (size_t i = 0; i < dim; i++)
+        {
+            adj[2 * tours[t][i]] = tours[t][(i + dim - 1) % dim];
+            adj[2 * tours[t][i] + 1] = tours[t][(i + 1) % dim];
+        }
+        // shared[i] stays set while the edge after position i of the first tour is in every tour
+        for (size_t i = 0; i < dim; i++)
+        {
+            uint32_t a = tours[0][i], b = tours[0][(i + 1) % dim];
+            shared[i] &= adj[2 * a] == b || adj[2 * a + 1] == b;
+        }
+    }
+
+    size_t fixed = 0;
+    for (size_t i = 0; i < dim; i++)
+        fixed += shared[i];
+    // Every edge shared means identical tours: nothing is left to evolve
+    if (fixed <= (bb && bb->nodes ? bb->fixed : 0) || fixed == dim || dim - fixed < min_nodes)
+    {
+        free(shared);
+        free(adj);
+        return 0;
+    }
+
+    // Paths of shared edges in the order of the first tour, starting after an unshared edge
+    size_t s = 0;
+    while (shared[s])
+        s++;
+    s = (s + 1) % dim;
+
+    size_t m = dim - fixed;
+    next->dim = dim;
+    next->nodes = m;
+    next->fixed = fixed;
+    next->first = (uint32_t *) malloc(sizeof(uint32_t) * m);
+    next->last = (uint32_t *) malloc(sizeof(uint32_t) * m);
+    next->start = (uint32_t *) malloc(sizeof(uint32_t) * (m + 1));
+    next->paths = (uint32_t *) malloc(sizeof(uint32_t) * dim);
+    next->node_of = (uint32_t *) malloc(sizeof(uint32_t) * dim);
+    next->inner = 0;
+
+    size_t v = 0;
+    for (size_t i = 0; i < dim; i++)
+    {
+        size_t p = (s + i) % dim;
+        uint32_t city = tours[0][p];
+        if (i == 0 || !shared[(p + dim - 1) % dim])
+        {
+            next->start[v] = i;
+            next->first[v] = city;
+            v++;
+        }
+        else
+            next->inner += tsp_round_dist(tsp, tours[0][(p + dim - 1) % dim], city);
+        next->paths[i] = city;
+        next->node_of[city] = v - 1;
+        next->last[v - 1] = city;
+    }
+    next->start[m] = dim;
+
+    free(shared);
+    free(adj);
+    return m;
+}
+
+void backbone_free(backbone_t *bb)
+{
+    free(bb->first);
+    free(bb->last);
+    free(bb->start);
+    free(bb->paths);
+    free(bb->node_of);
+    *bb = (backbone_t) {0};
+}
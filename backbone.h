@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tsp_parser.h"
+
+/*
+    Backbone edge fixing
+
+    Edges present in every elite tour of a converged population are fixed: the paths they form
+    are contracted into single nodes, and the GA evolves permutations of the nodes instead of the
+    cities. A node is a single city or a path that may be walked in either direction. The length
+    of a tour of nodes is the length of the shortest city tour visiting the nodes in that order,
+    found by a dynamic program over the orientations of the paths, so it is exact and expanding a
+    tour of nodes gives a city tour of that same length.
+*/
+
+typedef struct {
+    size_t dim;             // cities of the instance
+    size_t nodes;           // 0 while no edge is fixed
+    uint32_t *first, *last; // per node, the cities at the ends of its path, equal for single cities
+    uint32_t *start;        // per node, index in paths of its first city, nodes + 1 entries
+    uint32_t *paths;        // cities of every node's path in order
+    uint32_t *node_of;      // per city, the node it belongs to
+    int64_t inner;          // rounded length of all paths
+    size_t fixed;           // edges fixed
+} backbone_t;
+
+// Length of the shortest city tour visiting the bb->nodes nodes in the order of tour
+int64_t backbone_length(const backbone_t *bb, const tsp_2d_t *tsp, const uint32_t *tour);
+
+// Writes the shortest city tour visiting the nodes in the order of tour to cities
+void backbone_expand(const backbone_t *bb, const tsp_2d_t *tsp, const uint32_t *tour, uint32_t *cities);
+
+// Writes the tour of bb's nodes in the order their cities first appear in cities. A city tour
+// that contains every path keeps its length
+void backbone_compress(const backbone_t *bb, const uint32_t *cities, uint32_t *tour);
+
+// Builds in next the backbone of the edges shared by the n city tours, which always contain the
+// edges fixed by the current backbone bb (NULL for none). Returns the number of nodes of next,
+// or 0, leaving next unset, if no new edge is shared or fewer than min_nodes nodes would remain
+size_t backbone_fix(const backbone_t *bb, const tsp_2d_t *tsp, uint32_t *const *tours, int n, size_t min_nodes, backbone_t *next);
+
+void backbone_free(backbone_t *bb);
@@ -0,0 +1,54 @@
+#include "balance.h"
+#include <math.h>
+#include <stdlib.h>
+
+int balance_sizes(int islands, int *sizes, const double *seconds, int min)
+{
+    double slowest = 0, fastest = INFINITY, rates = 0;
+    int total = 0;
+    for (int i = 0; i < islands; i++)
+    {
+        if (seconds[i] <= 0)
+            return 0;
+        slowest = fmax(slowest, seconds[i]);
+        fastest = fmin(fastest, seconds[i]);
+        rates += sizes[i] / seconds[i];
+        total += sizes[i];
+        // Islands already below min keep their size as the least
+        if (sizes[i] < min)
+            min = sizes[i];
+    }
+    if (islands < 2 || slowest - fastest <= BALANCE_SLACK * slowest)
+        return 0;
+
+    int *next = (int *) malloc(sizeof(int) * islands);
+    int sum = 0, largest = 0;
+    for (int i = 0; i < islands; i++)
+    {
+        double share = total * (sizes[i] / seconds[i]) / rates;
+        next[i] = lround(sizes[i] + BALANCE_STEP * (share - sizes[i]));
+        if (next[i] < min)
+            next[i] = min;
+        sum += next[i];
+        if (next[i] > next[largest])
+            largest = i;
+    }
+
+    // Rounding and the minimum leave a few solutions to take from or give to the largest island,
+    // which has more than min to spare unless every island is at it
+    next[largest] += total - sum;
+    if (next[largest] < min)
+    {
+        free(next);
+        return 0;
+    }
+
+    int changed = 0;
+    for (int i = 0; i < islands; i++)
+    {
+        changed |= next[i] != sizes[i];
+        sizes[i] = next[i];
+    }
+    free(next);
+    return changed;
+}
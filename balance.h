@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+    Load balancing of island populations
+
+    Islands on slower cores, SMT siblings or cores shared with other work take longer to evolve
+    their share of the population, and the others wait for them at every crossing. After each
+    epoch an island's rate, solutions evolved per second, earns it a share of the population
+    proportional to it, the share with which all islands would have taken the same time. Sizes
+    move part of the way there, damping the noise of the timings, and are left alone while the
+    islands already finish within BALANCE_SLACK of each other.
+*/
+
+#define BALANCE_SLACK 0.05      // spread of the islands' times tolerated, relative to the longest
+#define BALANCE_STEP  0.5       // part of the way to the balanced sizes moved every epoch
+
+// Resizes the islands after an epoch in which island i evolved sizes[i] solutions in seconds[i],
+// keeping their total and at least min solutions in each. Returns 1 if any size changed
+int balance_sizes(int islands, int *sizes, const double *seconds, int min);
@@ -0,0 +1,175 @@
+#include "batch.h"
+#include "genetic.h"
+#include "tsp.h"
+#include "pool.h"
+#include "options.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    char *path;
+    char *json;             // path escaped as the contents of a JSON string
+    tsp_2d_t tsp;           // dim 0 if the file can't be read
+} batch_instance_t;
+
+typedef struct {
+    int line;
+    int instance;
+    long seed;
+    batch_params_t params;
+} batch_job_t;
+
+struct batch_arg {
+    batch_instance_t *instances;
+    batch_job_t *jobs;
+    FILE *out;
+};
+
+// Copy of s with the characters JSON strings can't hold as they are escaped
+static char *json_escape(const char *s)
+{
+    char *out = (char *) malloc(6 * strlen(s) + 1), *p = out;
+    for (; *s; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+        {
+            *p++ = '\\';
+            *p++ = c;
+        }
+        else if (c < 0x20)
+            p += sprintf(p, "\\u%04x", c);
+        else
+            *p++ = c;
+    }
+    *p = 0;
+    return out;
+}
+
+// Index of the instance read from path, reading it the first time
+static int find_instance(batch_instance_t **instances, int *n, const char *path)
+{
+    for (int i = 0; i < *n; i++)
+        if (strcmp((*instances)[i].path, path) == 0)
+            return i;
+
+    *instances = (batch_instance_t *) realloc(*instances, sizeof(batch_instance_t) * (*n + 1));
+    batch_instance_t *inst = &(*instances)[*n];
+    inst->path = strdup(path);
+    inst->json = json_escape(path);
+    inst->tsp = (tsp_2d_t) {0};
+    FILE *fd = fopen(path, "rt");
+    if (fd)
+    {
+        fclose(fd);
+        inst->tsp = tsp_2d_read(path);
+    }
+    return (*n)++;
+}
+
+// Parses the options after the seed, returns 0 on an unknown option or missing value
+static int parse_params(char **save, batch_params_t *params)
+{
+    options_t o = { .gens = params->gens, .population = params->population, .k = params->k, .mutations = params->mutations, .op = params->op };
+    if (!options_parse(save, "gkmMp", &o))
+        return 0;
+    *params = (batch_params_t) { .population = o.population, .gens = o.gens, .k = o.k, .mutations = o.mutations, .op = o.op };
+    return 1;
+}
+
+static void run_job(size_t j, int worker, void *_arg)
+{
+    struct batch_arg *arg = (struct batch_arg *) _arg;
+    batch_job_t *job = &arg->jobs[j];
+    batch_instance_t *inst = &arg->instances[job->instance];
+    batch_params_t *p = &job->params;
+
+    if (inst->tsp.dim < 2 || p->population < 2)
+    {
+        fprintf(arg->out, "{\"line\":%d,\"instance\":\"%s\",\"seed\":%ld,\"error\":\"%s\"}\n", job->line, inst->json, job->seed,
+                inst->tsp.dim < 2 ? "cannot read instance" : "population too small");
+        fflush(arg->out);
+        return;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    struct drand48_data rbuf;
+    srand48_r(job->seed, &rbuf);
+    tsp_context_t ctx = { .instance = &inst->tsp, .rbuf = &rbuf, .mutations = p->mutations };
+    tsp_set_local(&ctx);
+
+    size_t dim = inst->tsp.dim;
+    uint32_t *chunk = (uint32_t *) malloc(sizeof(uint32_t) * dim * p->population);
+    ga_solution_t *pop = (ga_solution_t *) malloc(sizeof(ga_solution_t) * p->population);
+    ga_init(pop, p->population, dim, sizeof(uint32_t), chunk, generate_tsp_solution);
+
+    for (int gen = 0; gen < p->gens; gen++)
+        tsp_engines[p->op](pop, p->population, p->k, p->mutations, &rbuf, NULL);
+
+    int64_t best = fitness(&pop[0]);
+    for (int i = 1; i < p->population; i++)
+        if (fitness(&pop[i]) < best)
+            best = pop[i].fitness;
+
+    free(pop);
+    free(chunk);
+    tsp_set_local(NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    fprintf(arg->out, "{\"line\":%d,\"instance\":\"%s\",\"seed\":%ld,\"population\":%d,\"generations\":%d,\"k\":%d,\"mutation\":%d,\"operator\":\"%s\",\"best\":%ld,\"seconds\":%.3f}\n",
+            job->line, inst->json, job->seed, p->population, p->gens, p->k, p->mutations, tsp_mutation_names[p->op], best, secs);
+    fflush(arg->out);
+}
+
+int batch_run(const char *manifest, batch_params_t defaults, int workers, FILE *out)
+{
+    FILE *fd = fopen(manifest, "rt");
+    if (!fd)
+        return -1;
+
+    batch_instance_t *instances = NULL;
+    batch_job_t *jobs = NULL;
+    int ninstances = 0, njobs = 0, line = 0;
+    char buf[BUFSIZ];
+
+    while (fgets(buf, sizeof(buf), fd))
+    {
+        line++;
+        char *save, *path = strtok_r(buf, OPTIONS_DELIM, &save);
+        if (!path || path[0] == '#')
+            continue;
+
+        char *seed = strtok_r(NULL, OPTIONS_DELIM, &save);
+        batch_job_t job = { .line = line, .params = defaults };
+        if (!seed || !parse_params(&save, &job.params))
+        {
+            fprintf(stderr, "%s:%d: expected '<file.tsp> <seed> [-g|-k|-m|-M|-p value]...'\n", manifest, line);
+            continue;
+        }
+        job.seed = atol(seed);
+        job.instance = find_instance(&instances, &ninstances, path);
+
+        jobs = (batch_job_t *) realloc(jobs, sizeof(batch_job_t) * (njobs + 1));
+        jobs[njobs++] = job;
+    }
+    fclose(fd);
+
+    pool_t *pool = pool_create(workers, 0);
+    struct batch_arg arg = { .instances = instances, .jobs = jobs, .out = out };
+    pool_run(pool, njobs, run_job, &arg);
+    pool_destroy(pool);
+
+    for (int i = 0; i < ninstances; i++)
+    {
+        free(instances[i].path);
+        free(instances[i].json);
+        tsp_2d_free(instances[i].tsp);
+    }
+    free(instances);
+    free(jobs);
+    return njobs;
+}
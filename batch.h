@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdio.h>
+
+/*
+    Batch mode: many runs in one process
+
+    A manifest lists one job per line: a TSPLIB file, a seed and optionally some of the -g, -p,
+    -k, -m and -M options, e.g.
+
+        data/qa194.tsp 7 -g 500 -M segment
+
+    Blank lines and lines starting with '#' are skipped. Each instance is parsed once and shared by
+    all its jobs. Every job is a single population evolved on one worker of a shared pool, and its
+    result is written as a JSON line as soon as it finishes.
+*/
+
+/* Parameters of jobs that don't set them */
+typedef struct {
+    int population;
+    int gens;
+    int k;
+    int mutations;
+    int op;                 // index in tsp_mutation_ops
+} batch_params_t;
+
+// Runs every job of the manifest on workers threads, returns the number of jobs or -1 if the
+// manifest can't be read
+int batch_run(const char *manifest, batch_params_t defaults, int workers, FILE *out);
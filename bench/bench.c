@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "../genetic.h"
+#include "../tsp_parser.h"
+#include "../tsp.h"
+#include "../prof.h"
+
+/*
+    Benchmark helper for bench.sh
+
+    bench kernels <file.tsp> [population]
+        Times the individual kernels (parse, init, fitness, fitness with the float and fixed point
+        coordinates of -R when they keep the distances, crossover, mutate, mutate_segment, and
+        fitness of a spatially ordered tour without and with Hilbert renumbering) on one instance
+        with a fixed seed and prints one CSV row per kernel.
+
+    bench exec <command> [args...]
+        Runs a command and prints its wall time and peak RSS, which the shell cannot measure
+        portably by itself.
+*/
+
+static tsp_2d_t tsp = {0};
+static int mutations = 1000;
+static struct drand48_data *rbufs = NULL;
+
+#define MIN_SECONDS 0.2
+
+// Instance name as used in bench.sh: file name without directory or extension
+static char *instance_name(const char *path)
+{
+    const char *b = strrchr(path, '/');
+    char *name = strdup(b ? b + 1 : path);
+    char *ext = strrchr(name, '.');
+    if (ext)
+        *ext = '\0';
+    return name;
+}
+
+static void report(const char *instance, const char *kernel, long ops, double secs)
+{
+    printf("%s,%s,%ld,%.1f,%.3f\n", instance, kernel, ops, secs * 1e9 / ops, secs * 1e9 / ops / tsp.dim);
+}
+
+static int kernels(const char *filename, int pop_size)
+{
+    char *instance = instance_name(filename);
+    double t0, t;
+    long ops;
+
+    rbufs = (struct drand48_data *) malloc(sizeof(struct drand48_data));
+    srand48_r(1, rbufs);
+
+    // Parse
+    ops = 0;
+    t0 = prof_seconds();
+    do
+    {
+        if (ops)
+            tsp_2d_free(tsp);
+        tsp = tsp_2d_read(filename);
+        ops++;
+    } while ((t = prof_seconds() - t0) < MIN_SECONDS);
+    report(instance, "parse", ops, t);
+    tsp_default = (tsp_context_t) { .instance = &tsp, .rbuf = rbufs, .mutations = mutations };
+
+    uint32_t *chunk = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim * pop_size);
+    ga_solution_t *pop = (ga_solution_t *) malloc(sizeof(ga_solution_t) * pop_size);
+    uint8_t *marks = (uint8_t *) malloc(sizeof(uint8_t) * tsp.dim);
+
+    // Init, one individual per op, the whole population is always built once
+    t0 = prof_seconds();
+    ga_init(pop, pop_size, tsp.dim, sizeof(uint32_t), chunk, generate_tsp_solution);
+    report(instance, "init", pop_size, prof_seconds() - t0);
+
+    // Fitness, cache flag cleared so every call walks the tour
+    ops = 0;
+    t0 = prof_seconds();
+    do
+    {
+        ga_solution_t *s = &pop[ops % pop_size];
+        s->fit_gen = 0;
+        fitness(s);
+        ops++;
+    } while ((t = prof_seconds() - t0) < MIN_SECONDS);
+    report(instance, "fitness", ops, t);
+
+    for (int mode = COORDS_FLOAT; mode < COORDS_MODES; mode++)
+    {
+        coords_t coords;
+        if (coords_init(&coords, &tsp, mode) != mode)
+            continue;
+        tsp_default.coords = &coords;
+        char kernel[32];
+        snprintf(kernel, sizeof(kernel), "fitness_%s", coords_names[mode]);
+        ops = 0;
+        t0 = prof_seconds();
+        do
+        {
+            ga_solution_t *s = &pop[ops % pop_size];
+            s->fit_gen = 0;
+            fitness(s);
+            ops++;
+        } while ((t = prof_seconds() - t0) < MIN_SECONDS);
+        report(instance, kernel, ops, t);
+        tsp_default.coords = NULL;
+        coords_free(&coords);
+    }
+
+    // Crossover into a scratch child, including the similarity check
+    ga_solution_t child = pop[0];
+    child.chromosome = malloc(sizeof(uint32_t) * tsp.dim);
+    ops = 0;
+    t0 = prof_seconds();
+    do
+    {
+        crossover(&pop[ops % pop_size], &pop[(ops + 1) % pop_size], &child, marks, rbufs);
+        ops++;
+    } while ((t = prof_seconds() - t0) < MIN_SECONDS);
+    report(instance, "crossover", ops, t);
+
+    // Mutate at the default rate
+    ops = 0;
+    t0 = prof_seconds();
+    do
+    {
+        mutate(&pop[ops % pop_size], mutations, rbufs);
+        ops++;
+    } while ((t = prof_seconds() - t0) < MIN_SECONDS);
+    report(instance, "mutate", ops, t);
+
+    ops = 0;
+    t0 = prof_seconds();
+    do
+    {
+        mutate_segment(&pop[ops % pop_size], mutations, rbufs);
+        ops++;
+    } while ((t = prof_seconds() - t0) < MIN_SECONDS);
+    report(instance, "mutate_segment", ops, t);
+
+    // Fitness of a tour along a Hilbert curve, which walks the plane in order like a good tour,
+    // with the file's numbering and then with the cities renumbered in that order (-H)
+    tsp_2d_t curve = { .dim = tsp.dim, .nodes = (tsp_2d_node_t *) malloc(sizeof(tsp_2d_node_t) * tsp.dim) };
+    memcpy(curve.nodes, tsp.nodes, sizeof(tsp_2d_node_t) * tsp.dim);
+    uint32_t *ids = tsp_2d_hilbert(&curve);
+    memcpy(child.chromosome, ids, sizeof(uint32_t) * tsp.dim);
+    ops = 0;
+    t0 = prof_seconds();
+    do
+    {
+        child.fit_gen = 0;
+        fitness(&child);
+        ops++;
+    } while ((t = prof_seconds() - t0) < MIN_SECONDS);
+    report(instance, "fitness_curve", ops, t);
+
+    for (uint32_t i = 0; i < tsp.dim; i++)
+        ((uint32_t *) child.chromosome)[i] = i;
+    tsp_default.instance = &curve;
+    ops = 0;
+    t0 = prof_seconds();
+    do
+    {
+        child.fit_gen = 0;
+        fitness(&child);
+        ops++;
+    } while ((t = prof_seconds() - t0) < MIN_SECONDS);
+    report(instance, "fitness_hilbert", ops, t);
+    tsp_default.instance = &tsp;
+    free(ids);
+    tsp_2d_free(curve);
+
+    free(child.chromosome);
+    free(marks);
+    free(pop);
+    free(chunk);
+    free(rbufs);
+    free(instance);
+    tsp_2d_free(tsp);
+    return 0;
+}
+
+static int exec_cmd(char **argv)
+{
+    double t0 = prof_seconds();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        execvp(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage ru;
+    if (pid < 0 || wait4(pid, &status, 0, &ru) < 0)
+    {
+        perror("bench exec");
+        return 1;
+    }
+
+    fprintf(stderr, "%.3f,%ld\n", prof_seconds() - t0, ru.ru_maxrss);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "kernels") == 0)
+        return kernels(argv[2], argc > 3 ? atoi(argv[3]) : 100);
+    if (argc >= 3 && strcmp(argv[1], "exec") == 0)
+        return exec_cmd(argv + 2);
+
+    fprintf(stderr, "Usage: '%s kernels <file.tsp> [population]' or '%s exec <command> [args...]'\n", argv[0], argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,94 @@
+#!/bin/bash
+
+# Reproducible benchmark over the bundled data/ instances.
+#
+# Usage: bench/bench.sh [output_dir] [instance ...]
+#
+# Builds the serial/pthread, OpenMP and (if mpicc is found) MPI binaries with -O3 into
+# bench/build, runs every instance with a fixed seed and configuration, and writes
+#   <output_dir>/runs.csv      one row per build and instance
+#   <output_dir>/kernels.csv   per-kernel timings from 'bench kernels'
+# Rows are sorted so two result directories can be compared with bench/compare.sh or diff.
+#
+# Environment: GAP (target gap in percent, default 10), CFLAGS (extra compiler flags),
+# MPIRUN (default "mpirun --oversubscribe")
+
+set -e
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+OUT="${1:-$ROOT/bench/results}"
+shift || true
+BUILD="$ROOT/bench/build"
+GAP="${GAP:-10}"
+MPIRUN="${MPIRUN:-mpirun --oversubscribe}"
+SRC="$ROOT/main.c $ROOT/genetic.c $ROOT/tsp_parser.c $ROOT/tsp.c $ROOT/tour.c $ROOT/diversity.c $ROOT/fcache.c $ROOT/pool.c $ROOT/decomp.c $ROOT/arena.c $ROOT/adapt.c $ROOT/batch.c $ROOT/events.c $ROOT/bound.c $ROOT/tune.c $ROOT/backbone.c $ROOT/profile.c $ROOT/options.c $ROOT/ils.c $ROOT/pack.c $ROOT/coords.c $ROOT/balance.c $ROOT/prof.c"
+
+# instance optimum generations population islands interval
+CONFIGS="\
+dj38     6656    2000 1000 4 100
+xqf131   564     2000 1000 4 100
+qa194    9352    2000 1000 4 100
+lu980    11340   1000 400  4 100
+rw1621   26051   500  200  4 100
+ca4663   1290319 200  80   4 50
+tz6117   394718  200  60   4 50
+ar9152   837479  100  40   4 50
+sw24978  855597  40   16   4 20
+ch71009  4566506 20   8    4 10"
+
+mkdir -p "$BUILD" "$OUT"
+
+gcc -O3 -Wall $CFLAGS -o "$BUILD/ga-tsp" $SRC -lrt -lm
+gcc -O3 -Wall $CFLAGS -fopenmp -o "$BUILD/ga-tsp-omp" $SRC -lrt -lm
+gcc -O3 -Wall $CFLAGS -o "$BUILD/bench" "$ROOT/bench/bench.c" "$ROOT/genetic.c" "$ROOT/tsp_parser.c" "$ROOT/tsp.c" "$ROOT/tour.c" "$ROOT/diversity.c" "$ROOT/fcache.c" "$ROOT/pool.c" "$ROOT/decomp.c" "$ROOT/arena.c" "$ROOT/adapt.c" "$ROOT/batch.c" "$ROOT/options.c" "$ROOT/backbone.c" "$ROOT/pack.c" "$ROOT/coords.c" "$ROOT/prof.c" -lrt -lm
+BUILDS="serial pthread openmp"
+if command -v mpicc > /dev/null; then
+    mpicc -O3 -Wall $CFLAGS -DMPI -o "$BUILD/ga-tsp-mpi" $SRC -lrt -lm
+    BUILDS="$BUILDS mpi"
+fi
+
+# First generation (and its time) where the best tour is within GAP% of the optimum
+time_to_gap() {
+    awk -F, -v opt="$2" -v gap="$GAP" 'NR > 1 && $3 <= opt * (1 + gap / 100) { print $2 "," $8; found = 1; exit }
+        END { if (!found) print "NA,NA" }' "$1"
+}
+
+RUNS="$OUT/runs.csv.tmp"
+KERNELS="$OUT/kernels.csv.tmp"
+: > "$RUNS"
+: > "$KERNELS"
+
+echo "$CONFIGS" | while read -r name opt gens pop islands interval; do
+    if [ $# -gt 0 ] && [[ ! " $* " =~ " $name " ]]; then
+        continue
+    fi
+    file="$ROOT/data/$name.tsp"
+    echo "Benchmarking $name" >&2
+
+    "$BUILD/bench" kernels "$file" "$pop" < /dev/null >> "$KERNELS"
+
+    for build in $BUILDS; do
+        n=$islands
+        case $build in
+            serial)  cmd=("$BUILD/ga-tsp" -t 1); n=1 ;;
+            pthread) cmd=("$BUILD/ga-tsp" -t "$islands" -u "$interval") ;;
+            openmp)  cmd=("$BUILD/ga-tsp-omp" -t "$islands" -u "$interval") ;;
+            mpi)     cmd=($MPIRUN -n $((islands + 1)) "$BUILD/ga-tsp-mpi" -t "$islands" -u "$interval") ;;
+        esac
+        csv="$BUILD/$name-$build.csv"
+        stats=$("$BUILD/bench" exec "${cmd[@]}" -r 1 -g "$gens" -p "$pop" -i "$interval" -o "$csv" "$file" 2>&1 > /dev/null < /dev/null | tail -1)
+        secs=${stats%,*}
+        rss=${stats#*,}
+        best=$(awk -F, 'END { print $3 }' "$csv")
+        gapped=$(time_to_gap "$csv" "$opt")
+        echo "$build,$name,$n,$pop,$gens,$secs,$(awk -v g="$gens" -v s="$secs" 'BEGIN { printf "%.2f", g / s }'),$rss,$best,$(awk -v b="$best" -v o="$opt" 'BEGIN { printf "%.2f", 100 * (b - o) / o }'),$gapped" >> "$RUNS"
+    done
+done
+
+echo "build,instance,islands,population,generations,seconds,gens_per_sec,peak_rss_kb,best,gap_pct,gens_to_gap,seconds_to_gap" > "$OUT/runs.csv"
+sort "$RUNS" >> "$OUT/runs.csv"
+echo "instance,kernel,ops,ns_per_op,ns_per_city" > "$OUT/kernels.csv"
+sort "$KERNELS" >> "$OUT/kernels.csv"
+rm -f "$RUNS" "$KERNELS"
+
+echo "Results written to $OUT" >&2
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Compares two bench.sh result directories and flags regressions.
+#
+# Usage: bench/compare.sh <old_dir> <new_dir> [threshold_percent]
+#
+# A run regresses when gens_per_sec drops, a kernel when ns_per_op grows, by more than the
+# threshold (default 5%). Exits with 1 if anything regressed.
+
+OLD="$1"
+NEW="$2"
+THRESHOLD="${3:-5}"
+
+if [ -z "$OLD" ] || [ -z "$NEW" ]; then
+    echo "Usage: '$0 <old_dir> <new_dir> [threshold_percent]'" >&2
+    exit 2
+fi
+
+# key columns, value column, 1 if higher is better
+compare() {
+    awk -F, -v keys="$3" -v col="$4" -v higher="$5" -v th="$THRESHOLD" -v what="$6" '
+        function key(   k, i, n, a) { n = split(keys, a, " "); k = $a[1]; for (i = 2; i <= n; i++) k = k "," $a[i]; return k }
+        FNR == 1 { next }
+        NR == FNR { old[key()] = $col; next }
+        key() in old && old[key()] > 0 {
+            d = 100 * ($col - old[key()]) / old[key()]
+            bad = higher ? d < -th : d > th
+            printf "%-10s %-28s %12.2f -> %12.2f  %+7.2f%%%s\n", what, key(), old[key()], $col, d, bad ? "  REGRESSION" : ""
+            if (bad) status = 1
+        }
+        END { exit status }' "$1" "$2"
+}
+
+status=0
+compare "$OLD/runs.csv" "$NEW/runs.csv" "1 2" 7 1 run || status=1
+compare "$OLD/kernels.csv" "$NEW/kernels.csv" "1 2" 4 0 kernel || status=1
+exit $status
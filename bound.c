@@ -0,0 +1,401 @@
+#include "bound.h"
+#include "tsp.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEIGHBORS   10      // candidate edges per city for large instances
+#define PERIOD_MIN  100     // iterations of the first period
+#define PERIOD_MAX  1000
+#define T_RANGE     64      // the ascent ends when steps are this much smaller than the first
+
+static struct {
+    const tsp_2d_t *tsp;
+    pthread_t thread;
+    int running;
+    int stop, done;         // accessed atomically
+    int64_t bound;          // accessed atomically
+
+    /* Candidate graph of large instances, city i's neighbors are adj[first[i] .. first[i + 1]) */
+    uint32_t *adj;
+    size_t *first;
+
+    /* Prim's scratch */
+    double *key;
+    int32_t *parent;
+    uint32_t *heap, *pos;   // binary heap of cities ordered by key, pos[c] its index or UINT32_MAX
+    char *in_tree;
+} b;
+
+static inline int stopped()
+{
+    return __atomic_load_n(&b.stop, __ATOMIC_RELAXED);
+}
+
+static void publish(double w)
+{
+    int64_t bound = (int64_t) ceil(w - 1e-6);
+    if (bound > __atomic_load_n(&b.bound, __ATOMIC_RELAXED))
+        __atomic_store_n(&b.bound, bound, __ATOMIC_RELAXED);
+}
+
+/* Candidate graph */
+
+// Links every city to its NEIGHBORS nearest and to the next city in a serpentine walk over the
+// grid cells, so that the graph is connected
+static void build_candidates()
+{
+    size_t n = b.tsp->dim;
+    int count;
+    uint32_t *sorted = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    uint32_t *nb = tsp_2d_nearest(b.tsp, NEIGHBORS, &count, sorted);
+
+    // Both directions of every neighbor and walk edge
+    b.first = (size_t *) calloc(n + 1, sizeof(size_t));
+    for (size_t i = 0; i < n; i++)
+        for (int k = 0; k < count; k++)
+        {
+            b.first[i + 1]++;
+            b.first[nb[i * NEIGHBORS + k] + 1]++;
+        }
+    for (size_t k = 0; k + 1 < n; k++)
+    {
+        b.first[sorted[k] + 1]++;
+        b.first[sorted[k + 1] + 1]++;
+    }
+    for (size_t i = 0; i < n; i++)
+        b.first[i + 1] += b.first[i];
+
+    size_t *fill_adj = (size_t *) malloc(sizeof(size_t) * n);
+    memcpy(fill_adj, b.first, sizeof(size_t) * n);
+    b.adj = (uint32_t *) malloc(sizeof(uint32_t) * b.first[n]);
+    for (size_t i = 0; i < n; i++)
+        for (int k = 0; k < count; k++)
+        {
+            uint32_t j = nb[i * NEIGHBORS + k];
+            b.adj[fill_adj[i]++] = j;
+            b.adj[fill_adj[j]++] = i;
+        }
+    for (size_t k = 0; k + 1 < n; k++)
+    {
+        b.adj[fill_adj[sorted[k]]++] = sorted[k + 1];
+        b.adj[fill_adj[sorted[k + 1]]++] = sorted[k];
+    }
+
+    free(fill_adj);
+    free(nb);
+    free(sorted);
+}
+
+/* 1-trees, return their cost including the penalties and fill deg */
+
+static void heap_up(uint32_t i)
+{
+    uint32_t c = b.heap[i];
+    for (; i > 0 && b.key[b.heap[(i - 1) / 2]] > b.key[c]; i = (i - 1) / 2)
+    {
+        b.heap[i] = b.heap[(i - 1) / 2];
+        b.pos[b.heap[i]] = i;
+    }
+    b.heap[i] = c;
+    b.pos[c] = i;
+}
+
+static uint32_t heap_pop(uint32_t *size)
+{
+    uint32_t top = b.heap[0], c = b.heap[--*size], i = 0;
+    b.pos[top] = UINT32_MAX;
+    while (2 * i + 1 < *size)
+    {
+        uint32_t m = 2 * i + 1;
+        if (m + 1 < *size && b.key[b.heap[m + 1]] < b.key[b.heap[m]])
+            m++;
+        if (b.key[b.heap[m]] >= b.key[c])
+            break;
+        b.heap[i] = b.heap[m];
+        b.pos[b.heap[i]] = i;
+        i = m;
+    }
+    if (*size > 0)
+    {
+        b.heap[i] = c;
+        b.pos[c] = i;
+    }
+    return top;
+}
+
+// Adds city 0's two cheapest edges among the given cities
+static double attach_first(const double *pi, int *deg, const uint32_t *cities, size_t count)
+{
+    double c1 = INFINITY, c2 = INFINITY;
+    uint32_t j1 = 0, j2 = 0;
+    for (size_t k = 0; k < count; k++)
+    {
+        uint32_t j = cities ? cities[k] : k + 1;
+        if (j == 0 || j == j1)
+            continue;
+        double w = tsp_round_dist(b.tsp, 0, j) + pi[0] + pi[j];
+        if (w < c1)
+        {
+            c2 = c1, j2 = j1;
+            c1 = w, j1 = j;
+        }
+        else if (w < c2 && j != j1)
+            c2 = w, j2 = j;
+    }
+    deg[0] = 2;
+    deg[j1]++;
+    deg[j2]++;
+    return c1 + c2;
+}
+
+static double tree_sparse(const double *pi, int *deg)
+{
+    size_t n = b.tsp->dim;
+    for (size_t i = 0; i < n; i++)
+    {
+        b.key[i] = INFINITY;
+        b.pos[i] = UINT32_MAX;
+        b.in_tree[i] = 0;
+        deg[i] = 0;
+    }
+
+    double total = 0;
+    uint32_t size = 1;
+    b.key[1] = 0;
+    b.parent[1] = -1;
+    b.heap[0] = 1;
+    b.pos[1] = 0;
+    while (size > 0)
+    {
+        uint32_t v = heap_pop(&size);
+        b.in_tree[v] = 1;
+        total += b.key[v];
+        if (b.parent[v] >= 0)
+        {
+            deg[v]++;
+            deg[b.parent[v]]++;
+        }
+        for (size_t e = b.first[v]; e < b.first[v + 1]; e++)
+        {
+            uint32_t u = b.adj[e];
+            if (u == 0 || b.in_tree[u])
+                continue;
+            double w = tsp_round_dist(b.tsp, v, u) + pi[v] + pi[u];
+            if (w < b.key[u])
+            {
+                b.key[u] = w;
+                b.parent[u] = v;
+                if (b.pos[u] == UINT32_MAX)
+                {
+                    b.heap[size] = u;
+                    b.pos[u] = size++;
+                }
+                heap_up(b.pos[u]);
+            }
+        }
+    }
+    return total + attach_first(pi, deg, b.adj + b.first[0], b.first[1] - b.first[0]);
+}
+
+// Over every edge, NAN if stopped
+static double tree_dense(const double *pi, int *deg)
+{
+    size_t n = b.tsp->dim;
+    uint32_t *left = b.heap;   // cities not in the tree yet
+    for (size_t i = 0; i < n; i++)
+    {
+        b.key[i] = INFINITY;
+        deg[i] = 0;
+    }
+    for (size_t i = 1; i < n; i++)
+        left[i - 1] = i;
+
+    double total = 0;
+    size_t count = n - 1;
+    b.key[1] = 0;
+    b.parent[1] = -1;
+    while (count > 0)
+    {
+        if (stopped())
+            return NAN;
+        size_t m = 0;
+        for (size_t k = 1; k < count; k++)
+            if (b.key[left[k]] < b.key[left[m]])
+                m = k;
+        uint32_t v = left[m];
+        left[m] = left[--count];
+
+        total += b.key[v];
+        if (b.parent[v] >= 0)
+        {
+            deg[v]++;
+            deg[b.parent[v]]++;
+        }
+        for (size_t k = 0; k < count; k++)
+        {
+            uint32_t u = left[k];
+            double w = tsp_round_dist(b.tsp, v, u) + pi[v] + pi[u];
+            if (w < b.key[u])
+            {
+                b.key[u] = w;
+                b.parent[u] = v;
+            }
+        }
+    }
+    return total + attach_first(pi, deg, NULL, n - 1);
+}
+
+/* Subgradient ascent */
+
+static double penalties(const double *pi, size_t n)
+{
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += pi[i];
+    return 2 * sum;
+}
+
+// Subgradient ascent from pi, deg holding pi's 1-tree, with steps of t. In the initial phase t
+// doubles while the bound improves. The best penalties are kept in best_pi and, if exact, every
+// improvement is published. Returns the best bound
+static double climb(double (*tree)(const double *, int *), int exact, double *pi, double *best_pi, int *deg, double w,
+                    int period, double t, int initial)
+{
+    size_t n = b.tsp->dim;
+    int *last = (int *) malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++)
+        last[i] = deg[i] - 2;
+    double best = w;
+    memcpy(best_pi, pi, sizeof(double) * n);
+    if (exact)
+        publish(w);
+
+    double t_min = t / T_RANGE;
+    int optimal = 0;
+
+    while (period > 0 && t >= t_min && !optimal && !stopped())
+    {
+        for (int p = 0; p < period && !stopped(); p++)
+        {
+            long norm = 0;
+            for (size_t i = 0; i < n; i++)
+                norm += (deg[i] - 2) * (deg[i] - 2);
+            if (norm == 0)
+            {
+                // The 1-tree is a tour, so no penalties do better
+                optimal = 1;
+                break;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                pi[i] += t * (0.7 * (deg[i] - 2) + 0.3 * last[i]);
+                last[i] = deg[i] - 2;
+            }
+
+            w = tree(pi, deg);
+            if (isnan(w))
+                break;
+            w -= penalties(pi, n);
+            if (w > best)
+            {
+                best = w;
+                memcpy(best_pi, pi, sizeof(double) * n);
+                if (exact)
+                    publish(w);
+                if (initial)
+                    t *= 2;
+                if (p == period - 1)
+                    period *= 2;
+            }
+            else if (initial && p > period / 2)
+            {
+                initial = 0;
+                p = 0;
+                t *= 0.75;
+            }
+        }
+        t /= 2;
+        period /= 2;
+    }
+    free(last);
+    return best;
+}
+
+static void *ascent(void *arg)
+{
+    size_t n = b.tsp->dim;
+    int dense = n <= BOUND_DENSE_MAX;
+    int period = n / 2 < PERIOD_MIN ? PERIOD_MIN : n / 2 > PERIOD_MAX ? PERIOD_MAX : n / 2;
+
+    double *pi = (double *) calloc(n, sizeof(double));
+    double *best_pi = (double *) calloc(n, sizeof(double));
+    int *deg = (int *) malloc(sizeof(int) * n);
+
+    // Steps start at a hundredth of the average edge of the first 1-tree
+    double w = dense ? tree_dense(pi, deg) : (build_candidates(), tree_sparse(pi, deg));
+    double t = 0.01 * w / n;
+
+    if (!dense)
+    {
+        // Most of the ascent on the candidate graph, then a short one over every edge from there
+        climb(tree_sparse, 0, pi, best_pi, deg, w, period, t, 1);
+        memcpy(pi, best_pi, sizeof(double) * n);
+        w = tree_dense(pi, deg) - penalties(pi, n);
+        if (!isnan(w))
+            climb(tree_dense, 1, pi, best_pi, deg, w, PERIOD_MIN, t, 0);
+    }
+    else
+        climb(tree_dense, 1, pi, best_pi, deg, w, period, t, 1);
+
+    free(deg);
+    free(best_pi);
+    free(pi);
+    __atomic_store_n(&b.done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void bound_start(const tsp_2d_t *tsp)
+{
+    size_t n = tsp->dim;
+    b = (typeof(b)) { .tsp = tsp };
+    if (n < 3)
+    {
+        b.done = 1;
+        return;
+    }
+    b.key = (double *) malloc(sizeof(double) * n);
+    b.parent = (int32_t *) malloc(sizeof(int32_t) * n);
+    b.heap = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    b.pos = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    b.in_tree = (char *) malloc(sizeof(char) * n);
+    b.running = 1;
+    pthread_create(&b.thread, NULL, ascent, NULL);
+}
+
+int64_t bound_get()
+{
+    return __atomic_load_n(&b.bound, __ATOMIC_RELAXED);
+}
+
+int bound_done()
+{
+    return __atomic_load_n(&b.done, __ATOMIC_ACQUIRE);
+}
+
+void bound_stop()
+{
+    if (!b.running)
+        return;
+    __atomic_store_n(&b.stop, 1, __ATOMIC_RELAXED);
+    pthread_join(b.thread, NULL);
+    free(b.key);
+    free(b.parent);
+    free(b.heap);
+    free(b.pos);
+    free(b.in_tree);
+    free(b.adj);
+    free(b.first);
+    b.running = 0;
+}
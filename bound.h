@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include "tsp_parser.h"
+
+/*
+    Held-Karp lower bound, computed in the background
+
+    A 1-tree is a spanning tree of all cities but the first plus the first city's two cheapest
+    edges, so it costs no more than the shortest tour. Adding a penalty pi[i] to every edge of
+    city i raises each tour's length by exactly 2 * sum(pi), so 1-tree(pi) - 2 * sum(pi) is a
+    lower bound for every pi. A subgradient ascent raises the penalties of cities of degree above 2
+    in the 1-tree and lowers those of leaves, in the step schedule of Helsgaun's LKH.
+
+    Edge lengths are rounded like the tour lengths. Instances of up to BOUND_DENSE_MAX cities
+    use every edge; larger ones do the ascent on the 10 nearest neighbors of each city, and only
+    the 1-tree over every edge at the end of each period, which is O(n^2), gives the bound.
+*/
+
+#ifndef BOUND_DENSE_MAX
+#define BOUND_DENSE_MAX 2000
+#endif
+
+// Starts the ascent on its own thread. tsp must not change until bound_stop
+void bound_start(const tsp_2d_t *tsp);
+
+// Best lower bound found so far, 0 if there is none yet
+int64_t bound_get();
+
+// Returns 1 once the ascent has finished
+int bound_done();
+
+// Stops the ascent, waiting for the thread to finish
+void bound_stop();
@@ -1,3 +1,3 @@
 #!/bin/bash
 
-gcc -Wall -o ga-tsp main.c genetic.c tsp_parser.c tsp.c -lrt -lm $1
+gcc -Wall -o ga-tsp main.c genetic.c tsp_parser.c tsp.c tour.c diversity.c fcache.c pool.c decomp.c arena.c adapt.c batch.c events.c bound.c tune.c backbone.c profile.c options.c ils.c pack.c coords.c balance.c prof.c -lrt -lm $1
@@ -0,0 +1,203 @@
+#include "coords.h"
+#include "prof.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIXED_DIGITS 9          // most decimal digits tried for fixed point
+
+const char *const coords_names[COORDS_MODES] = { "double", "float", "fixed" };
+
+int coords_find(const char *name)
+{
+    for (int i = 0; i < COORDS_MODES; i++)
+        if (strcmp(name, coords_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+// Rounded distance between cities a and b in mode, computed like dist does
+static inline int64_t distance(const coords_t *c, int mode, uint32_t a, uint32_t b)
+{
+    double n, m;
+    switch (mode)
+    {
+        case COORDS_FLOAT:
+            n = (double) c->f[2 * a] - c->f[2 * b];
+            m = (double) c->f[2 * a + 1] - c->f[2 * b + 1];
+            return round(sqrt(n*n + m*m));
+        case COORDS_FIXED:
+            n = (double) ((int64_t) c->q[2 * a] - c->q[2 * b]) * c->unit;
+            m = (double) ((int64_t) c->q[2 * a + 1] - c->q[2 * b + 1]) * c->unit;
+            return round(sqrt(n*n + m*m));
+        default:
+            n = c->tsp->nodes[a].x - c->tsp->nodes[b].x;
+            m = c->tsp->nodes[a].y - c->tsp->nodes[b].y;
+            return round(sqrt(n*n + m*m));
+    }
+}
+
+// Converting every coordinate back gives the same double, so each distance is computed from the
+// same values with the same operations
+static int setup_float(coords_t *c)
+{
+    const tsp_2d_t *tsp = c->tsp;
+    for (size_t i = 0; i < tsp->dim; i++)
+        if ((double) (float) tsp->nodes[i].x != tsp->nodes[i].x || (double) (float) tsp->nodes[i].y != tsp->nodes[i].y)
+            return 0;
+
+    c->f = (float *) malloc(sizeof(float) * 2 * tsp->dim);
+    for (size_t i = 0; i < tsp->dim; i++)
+    {
+        c->f[2 * i] = tsp->nodes[i].x;
+        c->f[2 * i + 1] = tsp->nodes[i].y;
+    }
+    c->exact = 1;
+    return 1;
+}
+
+static int fits(double x, double scale)
+{
+    double q = nearbyint(x * scale);
+    return fabs(q) < INT32_MAX && q / scale == x;
+}
+
+// Fewest decimal digits that keep every coordinate exact. The differences of integer units are
+// exact too, but not their quotient by a scale above 1, so then the candidate edges are checked
+static int setup_fixed(coords_t *c)
+{
+    const tsp_2d_t *tsp = c->tsp;
+    double scale = 1;
+    int digits = 0;
+    for (size_t i = 0; i < tsp->dim; i++)
+        if (!fits(tsp->nodes[i].x, scale) || !fits(tsp->nodes[i].y, scale))
+        {
+            if (++digits > FIXED_DIGITS)
+                return 0;
+            scale *= 10;
+            i = -1;
+        }
+
+    c->digits = digits;
+    c->scale = scale;
+    c->unit = 1 / scale;
+    c->q = (int32_t *) malloc(sizeof(int32_t) * 2 * tsp->dim);
+    for (size_t i = 0; i < tsp->dim; i++)
+    {
+        c->q[2 * i] = nearbyint(tsp->nodes[i].x * scale);
+        c->q[2 * i + 1] = nearbyint(tsp->nodes[i].y * scale);
+    }
+    c->exact = digits == 0;
+    return 1;
+}
+
+// Compares the rounded distances of every city to its nearest neighbors, the edges good tours
+// are made of, and to a random city with those of doubles
+static int check(coords_t *c)
+{
+    const tsp_2d_t *tsp = c->tsp;
+    int count;
+    uint32_t *nearest = tsp_2d_nearest(tsp, COORDS_NEIGHBORS, &count, NULL);
+    struct drand48_data rbuf;
+    srand48_r(1, &rbuf);
+
+    int same = 1;
+    for (uint32_t i = 0; i < tsp->dim && same; i++)
+    {
+        long r;
+        lrand48_r(&rbuf, &r);
+        same = distance(c, c->mode, i, r % tsp->dim) == distance(c, COORDS_DOUBLE, i, r % tsp->dim);
+        for (int j = 0; j < count && same; j++)
+        {
+            uint32_t b = nearest[i * COORDS_NEIGHBORS + j];
+            same = distance(c, c->mode, i, b) == distance(c, COORDS_DOUBLE, i, b);
+        }
+        c->checked += count + 1;
+    }
+    free(nearest);
+    return same;
+}
+
+void coords_free(coords_t *c)
+{
+    free(c->f);
+    free(c->q);
+    c->f = NULL;
+    c->q = NULL;
+    c->mode = COORDS_DOUBLE;
+}
+
+int coords_init(coords_t *c, const tsp_2d_t *tsp, int mode)
+{
+    *c = (coords_t) { .tsp = tsp, .mode = COORDS_DOUBLE, .scale = 1, .unit = 1 };
+    if (tsp->dim < 2 || mode == COORDS_DOUBLE)
+        return c->mode;
+
+    if ((mode < 0 || mode == COORDS_FLOAT) && setup_float(c))
+        c->mode = COORDS_FLOAT;
+    else if ((mode < 0 || mode == COORDS_FIXED) && setup_fixed(c))
+        c->mode = COORDS_FIXED;
+    if (c->mode == COORDS_FIXED && !c->exact && !check(c))
+        coords_free(c);
+    c->candidate = c->mode;
+
+    if (mode < 0 && c->mode != COORDS_DOUBLE)
+    {
+        coords_t ref = { .tsp = tsp, .mode = COORDS_DOUBLE };
+        c->rate = coords_rate(c, COORDS_SECONDS);
+        c->double_rate = coords_rate(&ref, COORDS_SECONDS);
+        if (c->rate < COORDS_GAIN * c->double_rate)
+            coords_free(c);
+    }
+    return c->mode;
+}
+
+// Inlined with a constant mode, leaving one loop per mode without a branch per edge
+static inline int64_t length(const coords_t *c, int mode, const uint32_t *tour, size_t n)
+{
+    int64_t d = distance(c, mode, tour[n - 1], tour[0]);
+    for (size_t i = 1; i < n; i++)
+        d += distance(c, mode, tour[i - 1], tour[i]);
+    return d;
+}
+
+int64_t coords_length(const coords_t *c, const uint32_t *tour, size_t n)
+{
+    switch (c->mode)
+    {
+        case COORDS_FLOAT:
+            return length(c, COORDS_FLOAT, tour, n);
+        case COORDS_FIXED:
+            return length(c, COORDS_FIXED, tour, n);
+        default:
+            return length(c, COORDS_DOUBLE, tour, n);
+    }
+}
+
+double coords_rate(const coords_t *c, double seconds)
+{
+    size_t n = c->tsp->dim;
+    uint32_t *tour = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    struct drand48_data rbuf;
+    srand48_r(1, &rbuf);
+    for (size_t i = 0; i < n; i++)
+    {
+        long r;
+        lrand48_r(&rbuf, &r);
+        size_t j = r % (i + 1);
+        tour[i] = tour[j];
+        tour[j] = i;
+    }
+
+    // The sum is kept so the calls aren't optimized away
+    volatile int64_t sink = 0;
+    long calls = 0;
+    double t, t0 = prof_seconds();
+    do
+    {
+        sink += coords_length(c, tour, n);
+        calls++;
+    } while ((t = prof_seconds() - t0) < seconds);
+    free(tour);
+    return calls * n / t;
+}
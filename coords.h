@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tsp_parser.h"
+
+/*
+    Reduced precision coordinates for the fitness
+
+    Tour lengths read every city's coordinates, 16 bytes as doubles. Most instances fit in 8:
+    float coordinates, used only if every coordinate is exactly a float, so that lengths are
+    those of doubles bit for bit, or fixed point coordinates, 32-bit integers counting units of
+    10^-digits with digits the fewest that keep every coordinate exact. With integer coordinates
+    fixed point lengths are again exact; otherwise the distances differ from those of doubles in
+    the last bits, and the mode is only used if no candidate edge (every city's nearest neighbors
+    and as many random ones) rounds to a different integer. Otherwise the doubles stay in use.
+
+    Half the bytes only pay off once the coordinates no longer fit in cache, and fixed point
+    costs conversions, so a mode picked automatically must also measure faster than doubles.
+*/
+
+#define COORDS_DOUBLE 0
+#define COORDS_FLOAT  1
+#define COORDS_FIXED  2
+#define COORDS_MODES  3
+
+#define COORDS_NEIGHBORS 8      // nearest neighbors of every city among the checked edges
+#define COORDS_SECONDS   0.05   // timing of each mode when picking one automatically
+#define COORDS_GAIN      1.05   // throughput over that of doubles a mode picked automatically needs
+
+typedef struct {
+    const tsp_2d_t *tsp;
+    int mode;
+    int digits;                 // decimal digits of the fixed point units
+    double scale;               // 10^digits
+    double unit;                // 1 / scale
+    float *f;                   // x and y of every city with COORDS_FLOAT
+    int32_t *q;                 // x and y of every city in units with COORDS_FIXED
+    int exact;                  // 1 if lengths are proven equal to those of doubles
+    size_t checked;             // candidate edges compared otherwise
+    int candidate;              // mode keeping the distances, in use unless it was slower
+    double rate, double_rate;   // coords_rate of candidate and of doubles, 0 if not measured
+} coords_t;
+
+extern const char *const coords_names[COORDS_MODES];
+
+// Index of the mode called name, -1 if there is none
+int coords_find(const char *name);
+
+// Sets up mode for tsp if it keeps the rounded distances of doubles, or with mode -1 the first
+// of float and fixed point that does if it is faster. Returns the mode in use
+int coords_init(coords_t *c, const tsp_2d_t *tsp, int mode);
+
+void coords_free(coords_t *c);
+
+// Length of tour, the sum of its rounded distances
+int64_t coords_length(const coords_t *c, const uint32_t *tour, size_t n);
+
+// Cities whose edges coords_length walks per second for random tours, timed for about seconds
+double coords_rate(const coords_t *c, double seconds);
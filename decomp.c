@@ -0,0 +1,283 @@
+#include "decomp.h"
+#include "tsp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_PASSES 100  // 2-opt passes over each junction window
+
+struct keyed {
+    double key;
+    uint32_t id;
+};
+
+struct solve_arg {
+    const tsp_2d_t *tsp;
+    uint32_t *ids;      // cities grouped by cluster
+    size_t *off;        // cluster c holds ids[off[c] .. off[c + 1])
+    uint32_t *tours;    // cluster tours, same layout as ids
+    decomp_solve_func solve;
+    void *arg;
+};
+
+static int cmp_keyed(const void *a, const void *b)
+{
+    double d = ((const struct keyed *) a)->key - ((const struct keyed *) b)->key;
+    return (d > 0) - (d < 0);
+}
+
+// Splits ids[lo .. lo + n) into parts clusters of nearly equal size, numbered from *next on.
+// ids is reordered so cluster c is ids[off[c] .. off[c + 1])
+static void bisect(const tsp_2d_t *tsp, uint32_t *ids, size_t lo, size_t n, int parts, struct keyed *tmp, size_t *off, int *next)
+{
+    if (parts <= 1)
+    {
+        off[(*next)++] = lo;
+        return;
+    }
+
+    uint32_t *r = ids + lo;
+    double xmin = INFINITY, xmax = -INFINITY, ymin = INFINITY, ymax = -INFINITY;
+    for (size_t i = 0; i < n; i++)
+    {
+        tsp_2d_node_t p = tsp->nodes[r[i]];
+        xmin = fmin(xmin, p.x);
+        xmax = fmax(xmax, p.x);
+        ymin = fmin(ymin, p.y);
+        ymax = fmax(ymax, p.y);
+    }
+
+    int use_y = ymax - ymin > xmax - xmin;
+    for (size_t i = 0; i < n; i++)
+        tmp[i] = (struct keyed) { .key = use_y ? tsp->nodes[r[i]].y : tsp->nodes[r[i]].x, .id = r[i] };
+    qsort(tmp, n, sizeof(struct keyed), cmp_keyed);
+    for (size_t i = 0; i < n; i++)
+        r[i] = tmp[i].id;
+
+    int left = parts / 2;
+    size_t m = n * left / parts;
+    bisect(tsp, ids, lo, m, left, tmp, off, next);
+    bisect(tsp, ids, lo + m, n - m, parts - left, tmp, off, next);
+}
+
+// Order in which to visit the clusters: nearest neighbour tour over the centroids, then 2-opt
+static void order_clusters(tsp_2d_node_t *centroids, int k, int *order)
+{
+    order[0] = 0;
+    if (k < 2)
+        return;
+
+    uint8_t *used = (uint8_t *) calloc(k, sizeof(uint8_t));
+    used[0] = 1;
+    for (int i = 1; i < k; i++)
+    {
+        int best = -1;
+        double bd = INFINITY;
+        for (int c = 0; c < k; c++)
+        {
+            double d = dist(centroids[order[i - 1]], centroids[c]);
+            if (!used[c] && d < bd)
+            {
+                bd = d;
+                best = c;
+            }
+        }
+        order[i] = best;
+        used[best] = 1;
+    }
+    free(used);
+
+    int improved = 1;
+    for (int pass = 0; improved && pass < MAX_PASSES; pass++)
+    {
+        improved = 0;
+        for (int i = 0; i < k - 2; i++)
+            for (int j = i + 2; j < k - (i == 0); j++)
+            {
+                tsp_2d_node_t a = centroids[order[i]], b = centroids[order[i + 1]];
+                tsp_2d_node_t c = centroids[order[j]], d = centroids[order[(j + 1) % k]];
+                if (dist(a, c) + dist(b, d) < dist(a, b) + dist(c, d) - 1e-9)
+                {
+                    for (int l = i + 1, r = j; l < r; l++, r--)
+                    {
+                        int aux = order[l];
+                        order[l] = order[r];
+                        order[r] = aux;
+                    }
+                    improved = 1;
+                }
+            }
+    }
+}
+
+static void solve_cluster(size_t c, int worker, void *_arg)
+{
+    struct solve_arg *a = (struct solve_arg *) _arg;
+    size_t n = a->off[c + 1] - a->off[c];
+    uint32_t *ids = a->ids + a->off[c];
+    uint32_t *out = a->tours + a->off[c];
+
+    if (n < 8)
+    {
+        memcpy(out, ids, sizeof(uint32_t) * n);
+        return;
+    }
+
+    tsp_2d_t sub = { .dim = n, .nodes = (tsp_2d_node_t *) malloc(sizeof(tsp_2d_node_t) * n) };
+    uint32_t *local = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    for (size_t i = 0; i < n; i++)
+        sub.nodes[i] = a->tsp->nodes[ids[i]];
+
+    a->solve(&sub, local, c, worker, a->arg);
+    for (size_t i = 0; i < n; i++)
+        out[i] = ids[local[i]];
+
+    free(local);
+    free(sub.nodes);
+}
+
+// 2-opt restricted to the 2 * w tour positions around position s. The window's end points stay
+// in place, so the rest of the tour is not affected
+static void refine_window(const tsp_2d_t *tsp, uint32_t *tour, size_t n, size_t s, size_t w)
+{
+    size_t L = 2 * w < n ? 2 * w : n;
+    size_t base = (s + n - L / 2) % n;
+    #define AT(q) tour[(base + (q)) % n]
+
+    int improved = 1;
+    for (int pass = 0; improved && pass < MAX_PASSES; pass++)
+    {
+        improved = 0;
+        for (size_t i = 0; i + 3 < L; i++)
+            for (size_t j = i + 2; j + 1 < L; j++)
+            {
+                uint32_t a = AT(i), b = AT(i + 1), c = AT(j), d = AT(j + 1);
+                if (tsp_round_dist(tsp, a, c) + tsp_round_dist(tsp, b, d)
+                    < tsp_round_dist(tsp, a, b) + tsp_round_dist(tsp, c, d))
+                {
+                    for (size_t l = i + 1, r = j; l < r; l++, r--)
+                    {
+                        uint32_t aux = AT(l);
+                        AT(l) = AT(r);
+                        AT(r) = aux;
+                    }
+                    improved = 1;
+                }
+            }
+    }
+    #undef AT
+}
+
+static int64_t tour_length(const tsp_2d_t *tsp, const uint32_t *tour)
+{
+    int64_t len = 0;
+    for (size_t i = 0; i < tsp->dim; i++)
+        len += tsp_round_dist(tsp, tour[i], tour[(i + 1) % tsp->dim]);
+    return len;
+}
+
+decomp_stats_t decomp_solve(const tsp_2d_t *tsp, size_t cluster_size, int window, pool_t *pool,
+                            decomp_solve_func solve, void *arg, uint32_t *tour)
+{
+    decomp_stats_t stats = {0};
+    size_t n = tsp->dim;
+    if (!n)
+        return stats;
+    if (cluster_size < 8)
+        cluster_size = 8;
+
+    /* Cluster */
+    uint32_t *ids = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    struct keyed *tmp = (struct keyed *) malloc(sizeof(struct keyed) * n);
+    for (size_t i = 0; i < n; i++)
+        ids[i] = i;
+    int k = (n + cluster_size - 1) / cluster_size;
+    size_t *off = (size_t *) malloc(sizeof(size_t) * (k + 1));
+    int next = 0;
+    bisect(tsp, ids, 0, n, k, tmp, off, &next);
+    off[k] = n;
+    free(tmp);
+
+    tsp_2d_node_t *centroids = (tsp_2d_node_t *) calloc(k, sizeof(tsp_2d_node_t));
+    int *order = (int *) malloc(sizeof(int) * k);
+    for (int c = 0; c < k; c++)
+    {
+        size_t m = off[c + 1] - off[c];
+        if (m > stats.largest)
+            stats.largest = m;
+        for (size_t i = off[c]; i < off[c + 1]; i++)
+        {
+            centroids[c].x += tsp->nodes[ids[i]].x / m;
+            centroids[c].y += tsp->nodes[ids[i]].y / m;
+        }
+    }
+    stats.clusters = k;
+    order_clusters(centroids, k, order);
+
+    /* Solve */
+    uint32_t *tours = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    struct solve_arg sarg = { .tsp = tsp, .ids = ids, .off = off, .tours = tours, .solve = solve, .arg = arg };
+    pool_run(pool, k, solve_cluster, &sarg);
+
+    /* Stitch: open each cluster tour where it best connects the previous cluster to the next */
+    size_t *junctions = (size_t *) malloc(sizeof(size_t) * k);
+    size_t pos = 0;
+    tsp_2d_node_t prev = centroids[order[k - 1]];
+    for (int oi = 0; oi < k; oi++)
+    {
+        int c = order[oi];
+        uint32_t *t = tours + off[c];
+        size_t m = off[c + 1] - off[c];
+        // The last cluster connects back to the start of the tour
+        tsp_2d_node_t nxt = prev;
+        if (oi + 1 < k)
+            nxt = centroids[order[oi + 1]];
+        else if (k > 1)
+            nxt = tsp->nodes[tour[0]];
+
+        size_t best = 0;
+        int fwd = 1;
+        double bcost = INFINITY;
+        for (size_t j = 0; j < m; j++)
+        {
+            tsp_2d_node_t a = tsp->nodes[t[j]], b = tsp->nodes[t[(j + 1) % m]];
+            double e = dist(a, b);
+            // Forward: enter at b, leave at a. Backward: enter at a, leave at b
+            double cf = dist(prev, b) + dist(a, nxt) - e;
+            double cb = dist(prev, a) + dist(b, nxt) - e;
+            if (cf < bcost)
+            {
+                bcost = cf;
+                best = j;
+                fwd = 1;
+            }
+            if (cb < bcost)
+            {
+                bcost = cb;
+                best = j;
+                fwd = 0;
+            }
+        }
+
+        junctions[oi] = pos;
+        for (size_t q = 0; q < m; q++)
+            tour[pos + q] = fwd ? t[(best + 1 + q) % m] : t[(best + m - q) % m];
+        pos += m;
+        prev = tsp->nodes[tour[pos - 1]];
+    }
+    stats.stitched = tour_length(tsp, tour);
+
+    /* Refine the junctions */
+    if (k > 1 && window > 0)
+        for (int oi = 0; oi < k; oi++)
+            refine_window(tsp, tour, n, junctions[oi], window);
+    stats.refined = tour_length(tsp, tour);
+
+    free(junctions);
+    free(tours);
+    free(order);
+    free(centroids);
+    free(off);
+    free(ids);
+    return stats;
+}
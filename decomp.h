@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tsp_parser.h"
+#include "pool.h"
+
+/*
+    Geometric decomposition of large instances
+
+    The cities are split into balanced clusters by recursive bisection along the longer side of
+    their bounding box. Each cluster is solved as an independent instance, so a worker only holds
+    the population of one cluster at a time. The clusters are visited in the order of a tour over
+    their centroids: each cluster tour is opened at the edge that best connects it to the previous
+    cluster and the next one, and the resulting tour is improved with 2-opt in a window around
+    every junction.
+*/
+
+typedef struct {
+    int clusters;
+    size_t largest;         // cities in the largest cluster
+    int64_t stitched;       // length of the joined cluster tours
+    int64_t refined;        // length after improving the junctions
+} decomp_stats_t;
+
+// Solves the sub-instance sub, writing a tour of its cities (0 .. sub->dim - 1) to tour.
+// worker is the index of the pool worker calling it
+typedef void (*decomp_solve_func)(const tsp_2d_t *sub, uint32_t *tour, int cluster, int worker, void *arg);
+
+// Solves tsp in clusters of at most cluster_size cities, in parallel over the pool, and writes
+// the full tour to tour. Clusters of fewer than 8 cities are visited in input order. window is
+// the number of tour positions improved on each side of a junction
+decomp_stats_t decomp_solve(const tsp_2d_t *tsp, size_t cluster_size, int window, pool_t *pool,
+                            decomp_solve_func solve, void *arg, uint32_t *tour);
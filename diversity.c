@@ -0,0 +1,95 @@
+#include "diversity.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define DIV_MAX_EDGES (1 << 22)
+
+uint64_t div_tour_hash(const uint32_t *tour, size_t n)
+{
+    uint64_t h = 0;
+    for (size_t i = 0; i + 1 < n; i++)
+        h ^= div_edge_hash(tour[i], tour[i + 1]);
+    if (n > 1)
+        h ^= div_edge_hash(tour[n - 1], tour[0]);
+    return h ? h : 1;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+int div_distinct_percent(ga_solution_t *pop, size_t size, uint64_t (*hash_func)(ga_solution_t *))
+{
+    if (!size)
+        return 0;
+
+    uint64_t *hashes = (uint64_t *) malloc(sizeof(uint64_t) * size);
+    for (size_t i = 0; i < size; i++)
+    {
+        if (!pop[i].hash)
+            pop[i].hash = hash_func(&pop[i]);
+        hashes[i] = pop[i].hash;
+    }
+    qsort(hashes, size, sizeof(uint64_t), cmp_u64);
+
+    size_t distinct = 1;
+    for (size_t i = 1; i < size; i++)
+        if (hashes[i] != hashes[i - 1])
+            distinct++;
+    free(hashes);
+
+    return distinct * 100 / size;
+}
+
+double div_edge_entropy(ga_solution_t *pop, size_t size, uint32_t *(*tour_func)(ga_solution_t *, int))
+{
+    size_t n = pop->chrom_len;
+    if (size < 2 || n < 3)
+        return 0;
+
+    size_t m = size;
+    if (m * n > DIV_MAX_EDGES)
+        m = DIV_MAX_EDGES / n;
+    if (m < 2)
+        m = 2;
+    size_t stride = size / m;
+
+    uint64_t *edges = (uint64_t *) malloc(sizeof(uint64_t) * m * n);
+    size_t e = 0;
+    for (size_t k = 0; k < m; k++)
+    {
+        ga_solution_t *sol = &pop[k * stride];
+        const uint32_t *tour = tour_func ? tour_func(sol, 0) : (const uint32_t *) sol->chromosome;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t a = tour[i], b = tour[(i + 1) % n];
+            edges[e++] = a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+        }
+    }
+    qsort(edges, e, sizeof(uint64_t), cmp_u64);
+
+    double h = 0;
+    size_t run = 1;
+    for (size_t i = 1; i <= e; i++)
+    {
+        if (i < e && edges[i] == edges[i - 1])
+        {
+            run++;
+            continue;
+        }
+        double p = (double) run / e;
+        h -= p * log(p);
+        run = 1;
+    }
+    free(edges);
+
+    // Identical tours give log(n), tours spreading evenly over every possible edge (or never
+    // sharing one, for small populations) give the maximum
+    double pairs = (double) n * (n - 1) / 2;
+    double hmax = log((double) e < pairs ? (double) e : pairs);
+    double norm = (h - log((double) n)) / (hmax - log((double) n));
+    return norm < 0 ? 0 : norm > 1 ? 1 : norm;
+}
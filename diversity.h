@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "genetic.h"
+
+/*
+    Population diversity for permutation (tour) chromosomes
+
+    A tour is hashed as the XOR of a hash of each of its undirected edges (Zobrist style), so
+    rotated and reversed copies of the same tour hash equally, and a move replacing some edges
+    can update the hash in O(1) per edge.
+*/
+
+// Hash of the undirected edge (a, b)
+static inline uint64_t div_edge_hash(uint32_t a, uint32_t b)
+{
+    uint64_t x = a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+    // splitmix64 finalizer
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Hash of a cyclic tour, never 0 so that 0 can mean "not computed"
+uint64_t div_tour_hash(const uint32_t *tour, size_t n);
+
+// Updates a tour hash for a move removing edge (a, b) and adding edge (c, d)
+static inline uint64_t div_hash_replace(uint64_t h, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    return h ^ div_edge_hash(a, b) ^ div_edge_hash(c, d);
+}
+
+// Percentage of solutions whose hash is not shared with an earlier solution.
+// Solutions without a hash get one
+int div_distinct_percent(ga_solution_t *pop, size_t size, uint64_t (*hash_func)(ga_solution_t *));
+
+// Normalized edge entropy of the population: 0 when every tour uses the same edges, 1 when edges
+// are spread as evenly as possible. Large populations are sampled so at most ~4M edges are counted.
+// Tours are read through tour_func if it is not NULL, its second argument being 0
+double div_edge_entropy(ga_solution_t *pop, size_t size, uint32_t *(*tour_func)(ga_solution_t *, int));
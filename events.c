@@ -0,0 +1,273 @@
+#include "events.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define STATS_QUEUE 64
+#define STATS_LINE  128
+#define FIFO_POLL   100         // ms between checks for a reader of the named pipe
+
+static struct {
+    int active;
+    int fd;                     // -1 until a named pipe has a reader, -2 once writing failed
+    char *fifo;                 // path of a named pipe, opened by the writer once it has a reader
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int quit;
+    struct timespec start;
+    size_t dim;
+    const uint32_t *ids;        // original index of every city, NULL if not renumbered
+
+    /* Newest best tour, swapped with the writer's buffer when taken */
+    int64_t best;               // also read without the lock to discard worse tours early
+    uint32_t *tour, *spare;
+    int best_gen;
+    double best_time;
+    int best_pending;
+    unsigned long best_count;
+
+    char stats[STATS_QUEUE][STATS_LINE];
+    int head, queued;
+    unsigned long dropped;
+
+    char *buf;                  // formatted tour, used by the writer only
+} ev = { .fd = -1 };
+
+static double elapsed()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - ev.start.tv_sec) + (now.tv_nsec - ev.start.tv_nsec) * 1e-9;
+}
+
+// Writes all of buf, closing the output on error so a reader going away doesn't stop the run
+static void write_all(const char *buf, size_t len)
+{
+    while (ev.fd >= 0 && len > 0)
+    {
+        ssize_t w = write(ev.fd, buf, len);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+        {
+            close(ev.fd);
+            ev.fd = -2;
+            return;
+        }
+        buf += w;
+        len -= w;
+    }
+}
+
+static void write_tour(const uint32_t *tour, int64_t length, int gen, double time, unsigned long count)
+{
+    char *p = ev.buf;
+    p += sprintf(p, "NAME : best.%lu\nTYPE : TOUR\nCOMMENT : Length = %ld, generation %d, %.3f s\nDIMENSION : %zu\nTOUR_SECTION\n",
+                 count, length, gen, time, ev.dim);
+    for (size_t i = 0; i < ev.dim; i++)
+        p += sprintf(p, "%u\n", (ev.ids ? ev.ids[tour[i]] : tour[i]) + 1);
+    p += sprintf(p, "-1\nEOF\n");
+    write_all(ev.buf, p - ev.buf);
+}
+
+// Opens the named pipe if it has a reader. Without one the open fails instead of blocking, so
+// the run can end without one ever coming. Once open, writes block like on any other output
+static void open_fifo()
+{
+    int fd = open(ev.fifo, O_WRONLY | O_NONBLOCK);
+    if (fd < 0)
+    {
+        if (errno != ENXIO && errno != EINTR)
+            ev.fd = -2;
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    ev.fd = fd;
+}
+
+static void *writer(void *arg)
+{
+    char stats[STATS_QUEUE][STATS_LINE];
+
+    pthread_mutex_lock(&ev.lock);
+    while (1)
+    {
+        // Until the named pipe has a reader events wait, the newest best tour replacing the
+        // previous one and statistics filling the queue. Those left at the end are dropped
+        if (ev.fd == -1 && ev.fifo)
+        {
+            open_fifo();
+            if (ev.fd == -1)
+            {
+                if (ev.quit)
+                    break;
+                struct timespec until;
+                clock_gettime(CLOCK_REALTIME, &until);
+                until.tv_nsec += FIFO_POLL * 1000000L;
+                until.tv_sec += until.tv_nsec / 1000000000L;
+                until.tv_nsec %= 1000000000L;
+                pthread_cond_timedwait(&ev.wake, &ev.lock, &until);
+                continue;
+            }
+        }
+
+        while (!ev.quit && !ev.best_pending && !ev.queued)
+            pthread_cond_wait(&ev.wake, &ev.lock);
+        if (!ev.best_pending && !ev.queued)
+            break;
+
+        // Take everything pending, then write it without holding the lock
+        int queued = ev.queued;
+        for (int i = 0; i < queued; i++)
+            memcpy(stats[i], ev.stats[(ev.head + i) % STATS_QUEUE], STATS_LINE);
+        ev.head = (ev.head + queued) % STATS_QUEUE;
+        ev.queued = 0;
+
+        int best_pending = ev.best_pending;
+        uint32_t *tour = ev.tour;
+        int64_t length = ev.best;
+        int gen = ev.best_gen;
+        double time = ev.best_time;
+        unsigned long count = ev.best_count;
+        if (best_pending)
+        {
+            ev.tour = ev.spare;
+            ev.spare = tour;
+            ev.best_pending = 0;
+        }
+        pthread_mutex_unlock(&ev.lock);
+
+        for (int i = 0; i < queued; i++)
+            write_all(stats[i], strlen(stats[i]));
+        if (best_pending)
+            write_tour(tour, length, gen, time, count);
+
+        pthread_mutex_lock(&ev.lock);
+    }
+    pthread_mutex_unlock(&ev.lock);
+    return NULL;
+}
+
+// Connects to the Unix stream socket at path, returns the socket or -1
+static int connect_unix(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int events_open(const char *target, size_t dim, const uint32_t *ids)
+{
+    struct stat st;
+    if (strncmp(target, "unix:", 5) == 0)
+    {
+        if ((ev.fd = connect_unix(target + 5)) < 0)
+            return -1;
+    }
+    else if (stat(target, &st) == 0 && S_ISFIFO(st.st_mode))
+        ev.fifo = strdup(target);
+    else if ((ev.fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        return -1;
+
+    // A reader closing a pipe or socket must not kill the run
+    signal(SIGPIPE, SIG_IGN);
+
+    ev.dim = dim;
+    ev.ids = ids;
+    ev.best = INT64_MAX;
+    ev.tour = (uint32_t *) malloc(sizeof(uint32_t) * dim);
+    ev.spare = (uint32_t *) malloc(sizeof(uint32_t) * dim);
+    ev.buf = (char *) malloc(dim * 11 + 256);
+    pthread_mutex_init(&ev.lock, NULL);
+    pthread_cond_init(&ev.wake, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &ev.start);
+    pthread_create(&ev.writer, NULL, writer, NULL);
+    ev.active = 1;
+    return 0;
+}
+
+void events_best(const uint32_t *tour, int64_t length, int gen)
+{
+    if (!ev.active || length >= __atomic_load_n(&ev.best, __ATOMIC_RELAXED))
+        return;
+
+    pthread_mutex_lock(&ev.lock);
+    if (length < ev.best)
+    {
+        __atomic_store_n(&ev.best, length, __ATOMIC_RELAXED);
+        memcpy(ev.tour, tour, sizeof(uint32_t) * ev.dim);
+        ev.best_gen = gen;
+        ev.best_time = elapsed();
+        ev.best_count++;
+        ev.best_pending = 1;
+        pthread_cond_signal(&ev.wake);
+    }
+    pthread_mutex_unlock(&ev.lock);
+}
+
+int64_t events_shortest()
+{
+    return ev.active ? __atomic_load_n(&ev.best, __ATOMIC_RELAXED) : INT64_MAX;
+}
+
+void events_stats(int island, int gen, int64_t best, int64_t average)
+{
+    if (!ev.active)
+        return;
+
+    double time = elapsed();
+    pthread_mutex_lock(&ev.lock);
+    if (ev.queued < STATS_QUEUE)
+    {
+        snprintf(ev.stats[(ev.head + ev.queued) % STATS_QUEUE], STATS_LINE, "STATS island %d generation %d best %ld average %ld time %.3f\n",
+                 island, gen, best, average, time);
+        ev.queued++;
+        pthread_cond_signal(&ev.wake);
+    }
+    else
+        ev.dropped++;
+    pthread_mutex_unlock(&ev.lock);
+}
+
+void events_close()
+{
+    if (!ev.active)
+        return;
+
+    pthread_mutex_lock(&ev.lock);
+    ev.quit = 1;
+    pthread_cond_signal(&ev.wake);
+    pthread_mutex_unlock(&ev.lock);
+    pthread_join(ev.writer, NULL);
+
+    if (ev.dropped)
+        fprintf(stderr, "events: %lu statistics lines dropped\n", ev.dropped);
+    if (ev.fd >= 0)
+        close(ev.fd);
+    free(ev.fifo);
+    free(ev.tour);
+    free(ev.spare);
+    free(ev.buf);
+    pthread_mutex_destroy(&ev.lock);
+    pthread_cond_destroy(&ev.wake);
+    ev.active = 0;
+}
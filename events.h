@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Streaming of progress events
+
+    Islands report new best tours and periodic statistics, and a background thread writes them to
+    a file, a named pipe or, with a "unix:" prefix, a Unix stream socket. Reporting only copies
+    the event under a lock, so evolution never waits on a slow reader. A best tour that arrives
+    before the previous one was written replaces it, and statistics lines that find the queue
+    full are dropped. Events wait for a reader of a named pipe, and are dropped if the run ends
+    before one comes.
+
+    Best tours are written as TSPLIB tour files, each ending with its EOF line:
+
+        NAME : best.3
+        TYPE : TOUR
+        COMMENT : Length = 9352, generation 240, 1.207 s
+        DIMENSION : 194
+        TOUR_SECTION
+        1
+        ...
+        -1
+        EOF
+
+    and statistics as single lines between them:
+
+        STATS island 0 generation 300 best 9352 average 10417 time 1.512
+*/
+
+// Starts the writer thread. Tours are written with city c as ids[c], or c if ids is NULL.
+// Returns 0, or -1 if target can't be opened
+int events_open(const char *target, size_t dim, const uint32_t *ids);
+
+// Reports a tour of the given length found at generation gen. Ignored unless it is shorter
+// than every tour reported before
+void events_best(const uint32_t *tour, int64_t length, int gen);
+
+// Length of the shortest tour reported so far, INT64_MAX if there is none or events are off
+int64_t events_shortest();
+
+// Reports an island's statistics, island -1 being the whole population
+void events_stats(int island, int gen, int64_t best, int64_t average);
+
+// Writes the pending events and stops the writer thread
+void events_close();
@@ -0,0 +1,75 @@
+#include "fcache.h"
+#include <stdlib.h>
+#include <string.h>
+
+void fcache_init(fcache_t *cache, size_t entries, int shared)
+{
+    size_t cap = 2;
+    while (cap < entries)
+        cap <<= 1;
+    cache->entries = (fcache_entry_t *) calloc(cap, sizeof(fcache_entry_t));
+    cache->mask = cap - 1;
+    cache->shared = shared;
+}
+
+void fcache_free(fcache_t *cache)
+{
+    free(cache->entries);
+    cache->entries = NULL;
+}
+
+void fcache_clear(fcache_t *cache)
+{
+    memset(cache->entries, 0, sizeof(fcache_entry_t) * (cache->mask + 1));
+}
+
+static inline fcache_entry_t read_entry(fcache_t *cache, size_t i)
+{
+    fcache_entry_t e;
+    if (cache->shared)
+    {
+        e.check = __atomic_load_n(&cache->entries[i].check, __ATOMIC_RELAXED);
+        e.value = __atomic_load_n(&cache->entries[i].value, __ATOMIC_RELAXED);
+    }
+    else
+        e = cache->entries[i];
+    return e;
+}
+
+static inline void write_entry(fcache_t *cache, size_t i, fcache_entry_t e)
+{
+    if (cache->shared)
+    {
+        __atomic_store_n(&cache->entries[i].check, e.check, __ATOMIC_RELAXED);
+        __atomic_store_n(&cache->entries[i].value, e.value, __ATOMIC_RELAXED);
+    }
+    else
+        cache->entries[i] = e;
+}
+
+int fcache_lookup(fcache_t *cache, uint64_t key, int64_t *value)
+{
+    size_t set = key & cache->mask & ~(size_t) 1;
+    for (size_t w = 0; w < 2; w++)
+    {
+        fcache_entry_t e = read_entry(cache, set + w);
+        if ((e.check ^ e.value) == key)
+        {
+            *value = (int64_t) e.value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void fcache_store(fcache_t *cache, uint64_t key, int64_t value)
+{
+    size_t set = key & cache->mask & ~(size_t) 1;
+    fcache_entry_t first = read_entry(cache, set);
+    fcache_entry_t e = { .check = key ^ (uint64_t) value, .value = (uint64_t) value };
+
+    // Demote the previous entry to the second way unless it is the same key
+    if ((first.check ^ first.value) != key)
+        write_entry(cache, set + 1, first);
+    write_entry(cache, set, e);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Bounded fitness cache keyed by a canonical solution hash
+
+    Two-way set associative, the most recently stored entry of a set sits in the first way.
+    A shared cache may be used by several threads at once without locks: each entry stores
+    key ^ value next to value, so a torn read or a concurrent overwrite shows up as a key
+    mismatch and is treated as a miss.
+*/
+
+typedef struct {
+    uint64_t check;     // key ^ value
+    uint64_t value;
+} fcache_entry_t;
+
+typedef struct {
+    fcache_entry_t *entries;
+    size_t mask;
+    int shared;
+} fcache_t;
+
+// Rounds entries up to a power of two, at least 2
+void fcache_init(fcache_t *cache, size_t entries, int shared);
+
+void fcache_free(fcache_t *cache);
+
+// Forgets every entry, for when keys stop identifying the same solutions
+void fcache_clear(fcache_t *cache);
+
+// Returns 1 and sets *value if key is cached. Keys must not be 0
+int fcache_lookup(fcache_t *cache, uint64_t key, int64_t *value);
+
+void fcache_store(fcache_t *cache, uint64_t key, int64_t value);
@@ -1,4 +1,6 @@
 #include "genetic.h"
+#include "genetic_engine.h"
+#include "prof.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -76,6 +78,7 @@ void ga_select_trunc(ga_solution_t *pop, size_t size, int criteria, int percent_
 // are replaced with offspring. If k >= 4, the parents are selected in one tournament and
 // the least fit losers are replaced with the offspring, otherwise two tournaments are held
 // which each yield one parent and one offspring. Offspring do not participate in the current tournament
+// ext may be NULL
 int ga_next_generation_tournament(ga_solution_t *pop,
                                   size_t size,
                                   int k,
@@ -84,147 +87,110 @@ int ga_next_generation_tournament(ga_solution_t *pop,
                                   void (*crossing_func)(ga_solution_t *, ga_solution_t *, ga_solution_t *, uint8_t *, struct drand48_data *),
                                   int mutation_per_Mi,
                                   void (*mutation_func)(ga_solution_t *, int, struct drand48_data *),
-                                  struct drand48_data *rbuf)
+                                  struct drand48_data *rbuf,
+                                  ga_ext_t *ext)
 {
-    /* Alg:
-        Mark all solutions as not dead
-        Let N = number of solutions replaced
-        For 1..size/2k
-            Hold 2 tournaments
-                Select k live individuals
-            Winners are parents, last-place-losers become offspring
-            Mark contestants as dead to avoid repeated selection
-        Increase generation
-    */
+    return ga_tournament_engine(pop, size, k, criteria, fitness_func, crossing_func, mutation_per_Mi, mutation_func, rbuf, ext);
+}
+
+/* Shared state of one ga_next_generation_batch call */
+struct batch_arg {
+    ga_solution_t *pop;
+    int *pairs;     // p1, p2, c1, c2 of each pair of tournaments
+    uint8_t *marks; // chrom_len bytes per worker
+    struct drand48_data *rbufs;
+    int64_t (*fitness_func)(ga_solution_t *);
+    void (*crossing_func)(ga_solution_t *, ga_solution_t *, ga_solution_t *, uint8_t *, struct drand48_data *);
+    int mutation_per_Mi;
+    void (*mutation_func)(ga_solution_t *, int, struct drand48_data *);
+};
+
+static void batch_evaluate(size_t i, int worker, void *_arg)
+{
+    struct batch_arg *arg = (struct batch_arg *) _arg;
+    arg->fitness_func(&arg->pop[i]);
+}
+
+static void batch_offspring(size_t t, int worker, void *_arg)
+{
+    struct batch_arg *arg = (struct batch_arg *) _arg;
+    ga_solution_t *pop = arg->pop;
+    int *q = &arg->pairs[4 * t];
+    uint8_t *marks = arg->marks + worker * pop->chrom_len;
+    struct drand48_data *rbuf = &arg->rbufs[worker];
+
+    for (int j = 0; j < 2; j++)
+    {
+        ga_solution_t *child = &pop[q[2 + j]];
+        PROF_START(t_cross);
+        arg->crossing_func(&pop[q[j]], &pop[q[1 - j]], child, marks, rbuf);
+        PROF_STOP(t_cross, PROF_CROSSOVER);
+        PROF_START(t_mut);
+        arg->mutation_func(child, arg->mutation_per_Mi, rbuf);
+        PROF_STOP(t_mut, PROF_MUTATE);
+        child->fit_gen = 0;
+        child->hash = 0;
+        arg->fitness_func(child);
+    }
+}
 
+// Steady-state variant of ga_next_generation_tournament for one large island. All tournaments
+// of the generation are held first, then the offspring are created and evaluated in parallel
+// by the pool and written over the losers.
+int ga_next_generation_batch(ga_solution_t *pop,
+                             size_t size,
+                             int k,
+                             int criteria,
+                             int64_t (*fitness_func)(ga_solution_t *i),
+                             void (*crossing_func)(ga_solution_t *, ga_solution_t *, ga_solution_t *, uint8_t *, struct drand48_data *),
+                             int mutation_per_Mi,
+                             void (*mutation_func)(ga_solution_t *, int, struct drand48_data *),
+                             pool_t *pool,
+                             struct drand48_data *rbufs)
+{
     if (!size)
         return 0;
 
-    for (size_t i = 0; i < size; i++)
-        pop[i].dead = 0;
-
     if (k < 2)
         k = 2;
 
-    int *contestants = (int *) malloc (sizeof(int) * k);
+    int N = size / (k * 2);
+    int *contestants = (int *) malloc(sizeof(int) * k);
     int64_t *fits = (int64_t *) malloc(sizeof(int64_t) * k);
-    uint8_t *marks = (uint8_t *) malloc(sizeof(uint8_t) * pop->chrom_len);
-    long lrand;
+    struct batch_arg arg = {
+        .pop = pop,
+        .pairs = (int *) malloc(sizeof(int) * 4 * N),
+        .marks = (uint8_t *) malloc(sizeof(uint8_t) * pop->chrom_len * pool_size(pool)),
+        .rbufs = rbufs,
+        .fitness_func = fitness_func,
+        .crossing_func = crossing_func,
+        .mutation_per_Mi = mutation_per_Mi,
+        .mutation_func = mutation_func
+    };
+
+    // Solutions changed outside the engine are evaluated in parallel before selection needs them
+    pool_run(pool, size, batch_evaluate, &arg);
 
-    // Number of tournaments. Lower k means more individuals get replaced
-    // per generation, but higher k means weak individuals win less often
-    int N = size / (k * 2);
+    for (size_t i = 0; i < size; i++)
+        pop[i].dead = 0;
 
+    // Every contestant is marked dead, so no individual takes part in two tournaments and the
+    // offspring never overwrite a parent of another pair
+    PROF_START(t_sel);
     for (int n = 0; n < N; n++)
     {
-        int p1 = 0, p2 = 0;
-        int c1 = 0, c2 = 0;
-        int64_t low = 0;
-        int64_t high = 0;
-
-        // Select contestants
-        for (int i = 0; i < k; i++)
-        {
-            lrand48_r(rbuf, &lrand);
-            int pot = lrand % size;
-            while (pop[pot].dead)
-                pot = (pot + 1) % size;
-            contestants[i] = pot;
-            pop[pot].dead = 1;
-        }
-
-        // Evaluate
-        for (int i = 0; i < k; i++)
-            fits[i] = fitness_func(&pop[contestants[i]]);
-
-        low = fits[0];
-        high = low;
-        p1 = contestants[0];
-        c1 = p1;
-        for (int i = 1; i < k; i++)
-        {
-            if (fits[i] < low)
-            {
-                low = fits[i];
-                p1 = contestants[i];
-            }
-            if (fits[i] > high)
-            {
-                high = fits[i];
-                c1 = contestants[i];
-            }
-        }
-
-        // Select contestants (round 2)
-        for (int i = 0; i < k; i++)
-        {
-            lrand48_r(rbuf, &lrand);
-            int pot = lrand % size;
-            while (pop[pot].dead)
-                pot = (pot + 1) % size;
-            contestants[i] = pot;
-            pop[pot].dead = 1;
-        }
-
-        p2 = contestants[0];
-        c2 = p2;
-        low = fitness_func(&pop[contestants[0]]);
-        high = low;
-
-        // Evaluate (round 2)
-        for (int i = 0; i < k; i++)
-            fits[i] = fitness_func(&pop[contestants[i]]);
-
-        // Pick parents and losers (offspring)
-        low = fits[0];
-        high = low;
-        p2 = contestants[0];
-        c2 = p2;
-        for (int i = 1; i < k; i++)
-        {
-            if (criteria == GA_MINIMIZE)
-            {
-                if (fits[i] < low)
-                {
-                    low = fits[i];
-                    p2 = contestants[i];
-                }
-                if (fits[i] > high)
-                {
-                    high = fits[i];
-                    c2 = contestants[i];
-                }
-            }
+        int *q = &arg.pairs[4 * n];
+        hold_tournament(pop, size, k, criteria, fitness_func, contestants, fits, &rbufs[0], &q[0], &q[2]);
+        hold_tournament(pop, size, k, criteria, fitness_func, contestants, fits, &rbufs[0], &q[1], &q[3]);
+    }
+    PROF_STOP(t_sel, PROF_SELECT);
 
-            if (criteria == GA_MAXIMIZE)
-            {
-                if (fits[i] > low)
-                {
-                    low = fits[i];
-                    p2 = contestants[i];
-                }
-                if (fits[i] < high)
-                {
-                    high = fits[i];
-                    c2 = contestants[i];
-                }
-            }
-        }
+    pool_run(pool, N, batch_offspring, &arg);
 
-        // Create offspring
-        crossing_func(&(pop[p1]), &(pop[p2]), &(pop[c1]), marks, rbuf);
-        mutation_func(&(pop[c1]), mutation_per_Mi, rbuf);
-        pop[c1].fit_gen = 0;
-        fitness_func(&pop[c1]);
-        
-        crossing_func(&(pop[p2]), &(pop[p1]), &(pop[c2]), marks, rbuf);
-        mutation_func(&(pop[c2]), mutation_per_Mi, rbuf);
-        pop[c2].fit_gen = 0;
-        fitness_func(&pop[c2]);
-    } 
     free(contestants);
     free(fits);
-    free(marks);
+    free(arg.pairs);
+    free(arg.marks);
 
     for (size_t i = 0; i < size; i++)
         pop[i].generation++;
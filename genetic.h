@@ -3,6 +3,8 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include "fcache.h"
+#include "pool.h"
 
 /*
     Functions used to execute the genetic algorithm
@@ -16,8 +18,25 @@ typedef struct {
     int64_t fitness;
     unsigned int fit_gen;   // auxiliary to help caching fitness
     void *chromosome;
+    uint64_t hash;          // canonical hash of the chromosome, 0 if not computed
 } ga_solution_t;
 
+/* Optional extensions to the tournament engine, zeroed members are disabled */
+typedef struct {
+    // Hash identifying equivalent solutions. Offspring identical to a member of the population
+    // are mutated again, up to clone_retries times, before being evaluated. Mutation operators
+    // either keep a computed hash up to date or reset it to 0
+    uint64_t (*hash_func)(ga_solution_t *);
+    int clone_retries;
+    // Offspring whose hash is cached skip evaluation. Requires hash_func
+    fcache_t *cache;
+
+    /* Statistics */
+    unsigned long clones;   // offspring found to be clones
+    unsigned long lookups, hits;
+    unsigned long offspring, improved;  // offspring created, and those fitter than their first parent
+} ga_ext_t;
+
 /* ga_select criteria */
 #define GA_MAXIMIZE 0
 #define GA_MINIMIZE 1
@@ -55,6 +74,7 @@ void ga_select_trunc(ga_solution_t *pop, size_t size, int criteria, int percent_
 // are replaced with offspring. If k >= 4, the parents are selected in one tournament and
 // the least fit losers are replaced with the offspring, otherwise two tournaments are held
 // which each yield one parent and one offspring. Offspring do not participate in the current tournament
+// ext may be NULL
 int ga_next_generation_tournament(ga_solution_t *pop,
                                   size_t size,
                                   int k,
@@ -63,7 +83,23 @@ int ga_next_generation_tournament(ga_solution_t *pop,
                                   void (*crossing_func)(ga_solution_t *, ga_solution_t *, ga_solution_t *, uint8_t *, struct drand48_data *),
                                   int mutation_per_Mi,
                                   void (*mutation_func)(ga_solution_t *, int, struct drand48_data *),
-                                  struct drand48_data *rbuf);
+                                  struct drand48_data *rbuf,
+                                  ga_ext_t *ext);
+
+// Steady-state variant of ga_next_generation_tournament for one large island. All tournaments
+// of the generation are held first, then the offspring are created and evaluated in parallel
+// by the pool and written over the losers. rbufs holds one PRNG per pool worker.
+// Engine extensions (clone rejection, fitness cache) are not applied
+int ga_next_generation_batch(ga_solution_t *pop,
+                             size_t size,
+                             int k,
+                             int criteria,
+                             int64_t (*fitness_func)(ga_solution_t *i),
+                             void (*crossing_func)(ga_solution_t *, ga_solution_t *, ga_solution_t *, uint8_t *, struct drand48_data *),
+                             int mutation_per_Mi,
+                             void (*mutation_func)(ga_solution_t *, int, struct drand48_data *),
+                             pool_t *pool,
+                             struct drand48_data *rbufs);
 
 // Retrieves some fitness information about the population. Requires pop to be
 // sorted by fitness
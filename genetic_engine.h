@@ -0,0 +1,249 @@
+#pragma once
+
+#include "genetic.h"
+#include "prof.h"
+#include <stdlib.h>
+
+/*
+    Tournament engine as an inline template
+
+    ga_tournament_engine and its helpers are always inlined, so a caller passing constant operators
+    gets an engine of its own calling them directly, and inlining them where they are defined in
+    the same translation unit. genetic.c instantiates it with function pointers as
+    ga_next_generation_tournament, tsp.c once per mutation operator as tsp_engines.
+*/
+
+#define GA_INLINE static inline __attribute__((always_inline))
+
+/* Set of solution hashes used to reject clones, open addressing, insert only */
+typedef struct {
+    uint64_t *keys;
+    size_t mask;
+} ga_hash_set_t;
+
+static inline void hash_set_init(ga_hash_set_t *set, size_t size)
+{
+    size_t cap = 16;
+    while (cap < 2 * size)
+        cap <<= 1;
+    set->keys = (uint64_t *) calloc(cap, sizeof(uint64_t));
+    set->mask = cap - 1;
+}
+
+// Inserts key, returns 1 if it was already present. Keys are never 0
+static inline int hash_set_insert(ga_hash_set_t *set, uint64_t key)
+{
+    size_t i = key & set->mask;
+    while (set->keys[i])
+    {
+        if (set->keys[i] == key)
+            return 1;
+        i = (i + 1) & set->mask;
+    }
+    set->keys[i] = key;
+    return 0;
+}
+
+// Mutates a freshly created offspring again while it duplicates a known solution, then records it.
+// Solutions replaced during this generation stay in the set, which only makes rejection stricter
+GA_INLINE void reject_clone(ga_solution_t *child,
+                            ga_hash_set_t *set,
+                            ga_ext_t *ext,
+                            void (*mutation_func)(ga_solution_t *, int, struct drand48_data *),
+                            struct drand48_data *rbuf)
+{
+    child->hash = ext->hash_func(child);
+    if (!hash_set_insert(set, child->hash))
+        return;
+
+    ext->clones++;
+    for (int r = 0; r < ext->clone_retries; r++)
+    {
+        // About half of the calls apply at least one mutation, which updates the hash
+        mutation_func(child, 1 << 19, rbuf);
+        if (!child->hash)
+            child->hash = ext->hash_func(child);
+        if (!hash_set_insert(set, child->hash))
+            return;
+    }
+}
+
+// Holds a tournament among k random live individuals and marks them dead to avoid repeated
+// selection. The fittest becomes a parent, the least fit is replaced by offspring
+GA_INLINE void hold_tournament(ga_solution_t *pop,
+                               size_t size,
+                               int k,
+                               int criteria,
+                               int64_t (*fitness_func)(ga_solution_t *),
+                               int *contestants,
+                               int64_t *fits,
+                               struct drand48_data *rbuf,
+                               int *parent,
+                               int *loser)
+{
+    long lrand;
+
+    // Select contestants
+    for (int i = 0; i < k; i++)
+    {
+        lrand48_r(rbuf, &lrand);
+        int pot = lrand % size;
+        while (pop[pot].dead)
+            pot = (pot + 1) % size;
+        contestants[i] = pot;
+        pop[pot].dead = 1;
+    }
+
+    // Evaluate
+    for (int i = 0; i < k; i++)
+        fits[i] = fitness_func(&pop[contestants[i]]);
+
+    int64_t low = fits[0];
+    int64_t high = low;
+    *parent = contestants[0];
+    *loser = *parent;
+    for (int i = 1; i < k; i++)
+    {
+        if (criteria == GA_MINIMIZE ? fits[i] < low : fits[i] > low)
+        {
+            low = fits[i];
+            *parent = contestants[i];
+        }
+        if (criteria == GA_MINIMIZE ? fits[i] > high : fits[i] < high)
+        {
+            high = fits[i];
+            *loser = contestants[i];
+        }
+    }
+}
+
+// Evaluates a new offspring, through the fitness cache if there is one
+GA_INLINE void evaluate_offspring(ga_solution_t *child, ga_ext_t *ext, int64_t (*fitness_func)(ga_solution_t *))
+{
+    if (!ext || !ext->cache)
+    {
+        fitness_func(child);
+        return;
+    }
+
+    if (!child->hash)
+        child->hash = ext->hash_func(child);
+    ext->lookups++;
+    if (fcache_lookup(ext->cache, child->hash, &child->fitness))
+    {
+        ext->hits++;
+        child->fit_gen = 1;
+        return;
+    }
+    fcache_store(ext->cache, child->hash, fitness_func(child));
+}
+
+static inline void count_offspring(ga_ext_t *ext, int64_t child, int64_t parent, int criteria)
+{
+    ext->offspring++;
+    if (criteria == GA_MINIMIZE ? child < parent : child > parent)
+        ext->improved++;
+}
+
+// Body of ga_next_generation_tournament
+GA_INLINE int ga_tournament_engine(ga_solution_t *pop,
+                                   size_t size,
+                                   int k,
+                                   int criteria,
+                                   int64_t (*fitness_func)(ga_solution_t *i),
+                                   void (*crossing_func)(ga_solution_t *, ga_solution_t *, ga_solution_t *, uint8_t *, struct drand48_data *),
+                                   int mutation_per_Mi,
+                                   void (*mutation_func)(ga_solution_t *, int, struct drand48_data *),
+                                   struct drand48_data *rbuf,
+                                   ga_ext_t *ext)
+{
+    /* Alg:
+        Mark all solutions as not dead
+        Let N = number of solutions replaced
+        For 1..size/2k
+            Hold 2 tournaments
+                Select k live individuals
+            Winners are parents, last-place-losers become offspring
+            Mark contestants as dead to avoid repeated selection
+        Increase generation
+    */
+
+    if (!size)
+        return 0;
+
+    for (size_t i = 0; i < size; i++)
+        pop[i].dead = 0;
+
+    if (k < 2)
+        k = 2;
+
+    int *contestants = (int *) malloc (sizeof(int) * k);
+    int64_t *fits = (int64_t *) malloc(sizeof(int64_t) * k);
+    uint8_t *marks = (uint8_t *) malloc(sizeof(uint8_t) * pop->chrom_len);
+
+    // Number of tournaments. Lower k means more individuals get replaced
+    // per generation, but higher k means weak individuals win less often
+    int N = size / (k * 2);
+
+    ga_hash_set_t set = {0};
+    if (ext && ext->hash_func && ext->clone_retries > 0)
+    {
+        hash_set_init(&set, size + 2 * N);
+        for (size_t i = 0; i < size; i++)
+        {
+            if (!pop[i].hash)
+                pop[i].hash = ext->hash_func(&pop[i]);
+            hash_set_insert(&set, pop[i].hash);
+        }
+    }
+
+    for (int n = 0; n < N; n++)
+    {
+        int p1, p2, c1, c2;
+
+        // Select parents and losers (offspring)
+        PROF_START(t_sel);
+        hold_tournament(pop, size, k, criteria, fitness_func, contestants, fits, rbuf, &p1, &c1);
+        hold_tournament(pop, size, k, criteria, fitness_func, contestants, fits, rbuf, &p2, &c2);
+        PROF_STOP(t_sel, PROF_SELECT);
+        int64_t f1 = pop[p1].fitness, f2 = pop[p2].fitness;
+
+        // Create offspring
+        PROF_START(t_cross);
+        crossing_func(&(pop[p1]), &(pop[p2]), &(pop[c1]), marks, rbuf);
+        PROF_STOP(t_cross, PROF_CROSSOVER);
+        PROF_START(t_mut);
+        mutation_func(&(pop[c1]), mutation_per_Mi, rbuf);
+        PROF_STOP(t_mut, PROF_MUTATE);
+        pop[c1].fit_gen = 0;
+        pop[c1].hash = 0;
+        if (set.keys)
+            reject_clone(&pop[c1], &set, ext, mutation_func, rbuf);
+        evaluate_offspring(&pop[c1], ext, fitness_func);
+        if (ext)
+            count_offspring(ext, pop[c1].fitness, f1, criteria);
+        
+        PROF_START(t_cross2);
+        crossing_func(&(pop[p2]), &(pop[p1]), &(pop[c2]), marks, rbuf);
+        PROF_STOP(t_cross2, PROF_CROSSOVER);
+        PROF_START(t_mut2);
+        mutation_func(&(pop[c2]), mutation_per_Mi, rbuf);
+        PROF_STOP(t_mut2, PROF_MUTATE);
+        pop[c2].fit_gen = 0;
+        pop[c2].hash = 0;
+        if (set.keys)
+            reject_clone(&pop[c2], &set, ext, mutation_func, rbuf);
+        evaluate_offspring(&pop[c2], ext, fitness_func);
+        if (ext)
+            count_offspring(ext, pop[c2].fitness, f2, criteria);
+    } 
+    free(contestants);
+    free(fits);
+    free(marks);
+    free(set.keys);
+
+    for (size_t i = 0; i < size; i++)
+        pop[i].generation++;
+
+    return pop->generation;
+}
@@ -0,0 +1,252 @@
+#include "ils.h"
+#include "tsp.h"
+#include "tour.h"
+#include <stdlib.h>
+#include <math.h>
+
+typedef struct {
+    const ils_candidates_t *c;
+    tour_t t;
+    uint32_t *queue;        // cities whose surroundings changed, circular
+    uint8_t *queued;        // per city, set while it is in queue
+    size_t head, size;
+    uint32_t (*log)[4];     // per 2-opt move since the last accepted kick, the move undoing it
+    size_t moves, cap;
+} search_t;
+
+static void push(search_t *s, uint32_t c)
+{
+    if (s->queued[c])
+        return;
+    s->queued[c] = 1;
+    s->queue[(s->head + s->size++) % s->t.n] = c;
+}
+
+static void move(search_t *s, uint32_t x1, uint32_t x2, uint32_t y1, uint32_t y2)
+{
+    tour_2opt_move(&s->t, x1, x2, y1, y2);
+    if (s->moves == s->cap)
+    {
+        s->cap *= 2;
+        s->log = realloc(s->log, sizeof(*s->log) * s->cap);
+    }
+    // The tour now holds x1 y1 .. x2 y2, both pointing the same way
+    uint32_t *m = s->log[s->moves++];
+    m[0] = x1;
+    m[1] = y1;
+    m[2] = x2;
+    m[3] = y2;
+}
+
+static void undo(search_t *s)
+{
+    while (s->moves > 0)
+    {
+        uint32_t *m = s->log[--s->moves];
+        tour_2opt_move(&s->t, m[0], m[1], m[2], m[3]);
+    }
+}
+
+// Same moves as tour_or_move and tour_double_bridge, logged so they can be undone
+static void or_move(search_t *s, uint32_t s1, uint32_t s2, uint32_t c, int rev)
+{
+    uint32_t p = tour_prev(&s->t, s1), n = tour_next(&s->t, s2);
+    uint32_t d = tour_next(&s->t, c);
+
+    move(s, p, s1, c, d);
+    if (c != n)
+        move(s, p, c, n, s2);
+    if (!rev && s1 != s2)
+        move(s, c, s2, s1, d);
+}
+
+static void double_bridge(search_t *s, uint32_t b1, uint32_t c1, uint32_t d1)
+{
+    uint32_t a2 = tour_prev(&s->t, b1), b2 = tour_prev(&s->t, c1), c2 = tour_prev(&s->t, d1);
+
+    move(s, a2, b1, c2, d1);
+    move(s, a2, c2, c1, b2);
+    move(s, c2, b2, b1, d1);
+}
+
+// Applies the first improving move found around city a and returns its change in length, or 0
+static int64_t improve(search_t *s, uint32_t a)
+{
+    const tsp_2d_t *tsp = s->c->tsp;
+    tour_t *t = &s->t;
+    const uint32_t *nb = s->c->nearest + (size_t) a * ILS_NEIGHBORS;
+
+    // 2-opt, replacing the edge after a and then the one before it with an edge to a neighbor
+    for (int dir = 0; dir < 2; dir++)
+    {
+        uint32_t b = dir ? tour_prev(t, a) : tour_next(t, a);
+        int64_t g = tsp_round_dist(tsp, a, b);
+        for (int k = 0; k < s->c->count; k++)
+        {
+            uint32_t c = nb[k];
+            int64_t ac = tsp_round_dist(tsp, a, c);
+            if (ac >= g)
+                break;
+            uint32_t d = dir ? tour_prev(t, c) : tour_next(t, c);
+            if (c == b || d == a)
+                continue;
+            int64_t delta = ac + tsp_round_dist(tsp, b, d) - g - tsp_round_dist(tsp, c, d);
+            if (delta < 0)
+            {
+                if (dir)
+                    move(s, b, a, d, c);
+                else
+                    move(s, a, b, c, d);
+                push(s, a);
+                push(s, b);
+                push(s, c);
+                push(s, d);
+                return delta;
+            }
+        }
+    }
+
+    // Or-opt, moving the path of 1 to 3 cities starting at a so that one of its ends meets a
+    // neighbor x, inserted between c and d with x either of them
+    uint32_t s2 = a;
+    for (int len = 1; len <= 3; len++, s2 = tour_next(t, s2))
+    {
+        uint32_t p = tour_prev(t, a), n = tour_next(t, s2);
+        int64_t g = tsp_round_dist(tsp, p, a) + tsp_round_dist(tsp, s2, n) - tsp_round_dist(tsp, p, n);
+        for (int end = 0; end < 2; end++)
+        {
+            uint32_t e = end ? s2 : a;
+            const uint32_t *enb = s->c->nearest + (size_t) e * ILS_NEIGHBORS;
+            for (int k = 0; k < s->c->count; k++)
+            {
+                uint32_t x = enb[k];
+                if (tsp_round_dist(tsp, e, x) >= g)
+                    break;
+                if (tour_between(t, a, x, s2))
+                    continue;
+                for (int side = 0; side < 2; side++)
+                {
+                    uint32_t c = side ? tour_prev(t, x) : x, d = tour_next(t, c);
+                    if (c == p || tour_between(t, a, c, s2))
+                        continue;
+                    // c is followed by s2 instead of a when that puts e next to x
+                    int rev = (side == 0) == (end == 1);
+                    uint32_t first = rev ? s2 : a, last = rev ? a : s2;
+                    int64_t delta = tsp_round_dist(tsp, c, first) + tsp_round_dist(tsp, last, d) - tsp_round_dist(tsp, c, d) - g;
+                    if (delta < 0)
+                    {
+                        or_move(s, a, s2, c, rev);
+                        push(s, p);
+                        push(s, n);
+                        push(s, a);
+                        push(s, s2);
+                        push(s, c);
+                        push(s, d);
+                        return delta;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Improves around every queued city until none is left and returns the change in length
+static int64_t local_search(search_t *s)
+{
+    int64_t delta = 0;
+    while (s->size > 0)
+    {
+        uint32_t a = s->queue[s->head];
+        s->head = (s->head + 1) % s->t.n;
+        s->size--;
+        s->queued[a] = 0;
+        delta += improve(s, a);
+    }
+    return delta;
+}
+
+// Double bridge with its cut points within ILS_STRETCH positions of a random city, returns the
+// change in length
+static int64_t kick(search_t *s, struct drand48_data *rbuf)
+{
+    const tsp_2d_t *tsp = s->c->tsp;
+    tour_t *t = &s->t;
+    size_t span = t->n - 2 < ILS_STRETCH ? t->n - 2 : ILS_STRETCH;
+    long r1, r2, r3;
+    lrand48_r(rbuf, &r1);
+    lrand48_r(rbuf, &r2);
+    lrand48_r(rbuf, &r3);
+
+    uint32_t b1 = r1 % t->n, c1 = b1, d1;
+    for (long i = 1 + r2 % (span / 2); i > 0; i--)
+        c1 = tour_next(t, c1);
+    d1 = c1;
+    for (long i = 1 + r3 % (span / 2); i > 0; i--)
+        d1 = tour_next(t, d1);
+
+    uint32_t a2 = tour_prev(t, b1), b2 = tour_prev(t, c1), c2 = tour_prev(t, d1);
+    int64_t delta = tsp_round_dist(tsp, a2, c1) + tsp_round_dist(tsp, c2, b1)
+                  + tsp_round_dist(tsp, b2, d1) - tsp_round_dist(tsp, a2, b1)
+                  - tsp_round_dist(tsp, b2, c1) - tsp_round_dist(tsp, c2, d1);
+    double_bridge(s, b1, c1, d1);
+    push(s, a2);
+    push(s, b1);
+    push(s, b2);
+    push(s, c1);
+    push(s, c2);
+    push(s, d1);
+    return delta;
+}
+
+void ils_init(ils_candidates_t *c, const tsp_2d_t *tsp)
+{
+    c->tsp = tsp;
+    c->nearest = tsp_2d_nearest(tsp, ILS_NEIGHBORS, &c->count, NULL);
+}
+
+void ils_free(ils_candidates_t *c)
+{
+    free(c->nearest);
+    c->nearest = NULL;
+}
+
+int64_t ils_run(const ils_candidates_t *c, uint32_t *tour, long kicks, struct drand48_data *rbuf)
+{
+    size_t n = c->tsp->dim;
+    int64_t length = 0;
+    for (size_t i = 0; i < n; i++)
+        length += tsp_round_dist(c->tsp, tour[i], tour[(i + 1) % n]);
+    if (n < 8)
+        return length;
+
+    search_t s = { .c = c, .cap = 64 };
+    tour_init(&s.t, n);
+    tour_load(&s.t, tour);
+    s.queue = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    s.queued = (uint8_t *) calloc(n, sizeof(uint8_t));
+    s.log = malloc(sizeof(*s.log) * s.cap);
+
+    for (size_t i = 0; i < n; i++)
+        push(&s, tour[i]);
+    length += local_search(&s);
+
+    // Kicks that end up longer are undone, so the tour is always the best found
+    for (long i = 0; i < kicks; i++)
+    {
+        s.moves = 0;
+        int64_t next = length + kick(&s, rbuf);
+        next += local_search(&s);
+        if (next <= length)
+            length = next;
+        else
+            undo(&s);
+    }
+
+    tour_store(&s.t, tour);
+    free(s.log);
+    free(s.queued);
+    free(s.queue);
+    tour_free(&s.t);
+    return length;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "tsp_parser.h"
+
+/*
+    Iterated local search on a single tour
+
+    The tour is improved with 2-opt and Or-opt moves between every city and its nearest
+    neighbors, taking cities from a queue of those whose surroundings changed (don't-look bits).
+    Then it is repeatedly kicked with a double bridge inside a short stretch of the tour and
+    improved again, keeping the result unless it is longer. Moves run on the segmented tour of
+    tour.h, so each costs O(sqrt n), and the moves of a rejected kick are undone in reverse.
+*/
+
+#define ILS_NEIGHBORS 8     // candidate cities of every move
+#define ILS_STRETCH   50    // tour positions a kick spans at most
+
+typedef struct {
+    const tsp_2d_t *tsp;
+    uint32_t *nearest;      // ILS_NEIGHBORS per city, nearest first
+    int count;              // of them in use, fewer for tiny instances
+} ils_candidates_t;
+
+void ils_init(ils_candidates_t *c, const tsp_2d_t *tsp);
+
+void ils_free(ils_candidates_t *c);
+
+// Improves tour, a permutation of the cities, with kicks kicks and returns its length
+int64_t ils_run(const ils_candidates_t *c, uint32_t *tour, long kicks, struct drand48_data *rbuf);
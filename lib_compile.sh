@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Builds the solver library (see solver.h) as libga-tsp.a and libga-tsp.so
+SRC="genetic.c tsp_parser.c tsp.c tour.c diversity.c fcache.c pool.c decomp.c arena.c adapt.c batch.c options.c backbone.c pack.c coords.c prof.c solver.c"
+mkdir -p lib-obj
+for f in $SRC; do
+    gcc -Wall -fPIC -c -o lib-obj/${f%.c}.o $f $1 || exit 1
+done
+ar rcs libga-tsp.a lib-obj/*.o
+gcc -shared -o libga-tsp.so lib-obj/*.o -lrt -lm -lpthread
+rm -r lib-obj
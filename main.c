@@ -4,6 +4,8 @@
 #include <string.h>
 #include <math.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <time.h>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -18,12 +20,36 @@
 #include "genetic.h"
 #include "tsp_parser.h"
 #include "tsp.h"
+#include "prof.h"
+#include "diversity.h"
+#include "decomp.h"
+#include "arena.h"
+#include "adapt.h"
+#include "batch.h"
+#include "events.h"
+#include "bound.h"
+#include "tune.h"
+#include "backbone.h"
+#include "profile.h"
+#include "ils.h"
+#include "pack.h"
+#include "coords.h"
+#include "balance.h"
 
 #define SEL_TRUNCATE   0
 #define SEL_TOURNAMENT 1
 
+#define DECOMP_WINDOW  50   // tour positions improved on each side of a cluster junction
+#ifndef BACKBONE_STALL
+#define BACKBONE_STALL 1    // percentage the best tour must improve by per -F interval to delay fixing
+#endif
+
 tsp_2d_t tsp = {0};
 FILE *csv = NULL;
+struct timespec t_start;        // start of evolution, for the CSV time column
+char *decisions_filename = NULL;    // adaptation decisions as CSV
+FILE *decisions = NULL;
+int island_base = 0;            // island number of the process's island 0, nonzero in MPI slaves
 
 #ifndef _OPENMP
 #ifndef MPI
@@ -33,6 +59,14 @@ pthread_t *threads = NULL;
 
 int *thread_bounds = NULL;
 struct drand48_data *rbufs = NULL;
+ga_ext_t *exts = NULL;          // per island engine extensions, the last one for the main thread
+adapt_t *adapts = NULL;         // per island parameters in use, same layout as exts
+ga_ext_t ext_shown;             // counters of exts already shown and reset by gen_info, islands add in parallel
+fcache_t *caches = NULL;        // per island fitness caches, or a single shared one
+pool_t **pools = NULL;          // per island offspring workers, only with island_workers > 1
+struct drand48_data *worker_rbufs = NULL; // island_workers PRNGs per pool
+int *island_cpus = NULL;        // core each island's thread is pinned to, only with numa_local
+arena_t arenas[2];              // chromosomes and solutions, only with numa_local
 
 /* Parameters */
 int population_size = 2500;     // population size per thread
@@ -40,6 +74,7 @@ int max_gens = 3000;            // when to stop the algorithm
 int gen_info_interval = 100;    // how often to print information about the population
 int mutations = 1000;           // mutations / (1024*1024) = mutation chance
 int num_threads = 1;            // number of islands to evolve
+int threads_given = 0;          // if 1 -t was set, which -I doesn't override
 int island_cross_interval = 0;  // how often island populations are allowed to cross
 int f_answer = 0;               // if 1 print shortest path found
 int sel_strat = SEL_TOURNAMENT; // selection strategy 
@@ -49,28 +84,81 @@ int percent_dead = 50;          // how many solutions get replaced
 int percent_cross = 50;         // how many solutions are derived from crossover
     /* Tournament selection */
 int tournament_size = 4;        // how many individuals get picked per tournament
+char *prof_filename = NULL;     // per-phase timing report, needs a -DPROF build
+int mutation_op = 0;            // index in tsp_mutation_ops
+int adapt_window = 0;           // if above 0 adapt parameters every this many generations
+int diversity = 0;              // if 1 reject clones and report diversity metrics
+int cache_entries = 0;          // fitness cache size per island, negative for one shared cache
+int island_workers = 1;         // threads creating offspring for each island
+int decomp_size = 0;            // if above 0 solve the instance in clusters of this many cities
+int numa_local = 0;             // if 1 pin islands to cores and place their memory on the core's node
+char *batch_manifest = NULL;    // if set run the jobs it lists instead of a single run
+char *events_target = NULL;     // if set stream best tours and statistics to it
+char **warm_files = NULL;       // tours to start from
+int warm_count = 0;
+int percent_warm = 10;          // how much of each island starts from the warm tours
+double gap_target = -1;         // if 0 or above compute a lower bound, above 0 stop within this gap
+int hilbert = 0;                // if 1 renumber the cities along a Hilbert curve
+uint32_t *city_ids = NULL;      // original index of every city when renumbered
+int auto_tune = 0;              // if 1 pick -t, -p and -u from a calibration run
+int population_given = 0;       // if 1 -p was set, which -T only grows saying so
+int backbone_interval = 0;      // if above 0 fix the edges shared by all elites every this many generations
+backbone_t backbone = {0};      // fixed paths, chromosomes are tours of its nodes once it has any
+int backbone_gen = 0;           // generation of the last check
+int64_t backbone_best = 0;      // best tour length at the last check
+char *profile_file = NULL;      // if set read per-island parameters from it
+profile_t *profiles = NULL;
+int profile_count = 0;
+int *island_sizes = NULL;       // population of every island when profiles set it
+ils_candidates_t ils = {0};     // neighbor lists for the islands of -X ils profiles
+int packed = 0;                 // if 1 store tours as their differences to a reference tour per island
+pack_t pack = {0};
+int coord_mode = -1;            // coordinates fitness reads, -1 for the most compact keeping every distance
+coords_t coords = {0};
+int balance = 0;                // if 1 resize the islands to their speed at every crossing
 
 /* CLI arguments 
 
     -a      print the shortest path found
+    -A      adaptive parameter window
+    -b      offspring workers per island
+    -B      batch job manifest
     -c      cross percentage (trunc)
+    -C      fitness cache entries
     -d      dead percentage (trunc)
+    -D      reject clones, report diversity
     -e      elite percentage (trunc)
+    -E      stream events to file, pipe or socket
     -f      TSP file, exclude duplications
+    -F      backbone fixing interval
     -g      generations
     -h      print help
+    -H      Hilbert curve city order
     -i      gen. info interval
+    -I      island profiles file
     -k      tournament size
     -l      TSP file, keep duplications
+    -L      lower bound, target gap
     -m      mutation rate
+    -M      mutation operator
+    -N      NUMA-local islands
     -o      output gen info to file as CSV format
+    -O      output adaptation decisions as CSV
     -p      population size
+    -P      output per-phase profiling report as CSV
     -r      PRNG seed
+    -R      coordinate precision
     -s      switch to truncation
     -t      island (thread) count
+    -T      auto configuration, also --auto
     -u      island crossover interval
+    -U      balance island sizes
+    -w      warm start tour file
+    -W      warm start percentage
+    -x      decomposition cluster size
+    -Z      packed population storage
 
-    Of these only -h and -s don't take arguments
+    Of these only -a, -D, -h, -H, -N, -s, -T, -U and -Z don't take arguments
 */
 
 void print_help(char **argv)
@@ -80,14 +168,70 @@ Usage: %s [options] <file.tsp>\n\
 \n\
   Options:\n\
     -a              Print the shortest path found after finishing evolution.\n\n\
+    -A [integer]    Adapt each island's mutation rate, tournament size and mutation\n\
+                    operator every this many generations, starting from -m, -k and\n\
+                    -M. The success rate (S) is the share of offspring fitter than\n\
+                    their parent, and the rate steers it to 10%%: it rises while\n\
+                    fewer succeed and falls while more do. The tournament shrinks\n\
+                    while the best tour stalls and grows back up to -k while it\n\
+                    improves. The operator is picked by a discounted UCB1 bandit\n\
+                    rewarded with the success rate. Statistics show the values in\n\
+                    use and S of the last window, and unless -i is 0 or -1 every\n\
+                    decision is printed with the values it replaced (see -O).\n\
+                        Default: 0 (fixed parameters)\n\n\
+    -b [integer]    Number of threads creating offspring for each island. With more\n\
+                    than one, all tournaments of a generation are held first and\n\
+                    the offspring are then created and evaluated in parallel, with\n\
+                    idle threads stealing work from busy ones. Meant for few large\n\
+                    islands. Ignores -A, -C and -D.\n\
+                        Default: 1\n\n\
+    -B [filename]   Batch mode: run every job of the manifest, one per line as\n\
+                    '<file.tsp> <seed> [-g|-k|-m|-M|-p value]...', as single\n\
+                    populations spread over as many threads as islands. Options not\n\
+                    given in a job take the command line's values. Instances are\n\
+                    read once, and results are printed as JSON lines as jobs finish.\n\
+                    Not available with MPI.\n\n\
+    -C [integer]    Entries of each island's fitness cache. Offspring identical to\n\
+                    a recently evaluated tour (including rotated or reversed copies)\n\
+                    take its length instead of being evaluated. A negative value\n\
+                    shares one lock-free cache of that size among all islands.\n\
+                    Statistics show the hit rate since the previous line (C),\n\
+                    and over the whole run on the final line of all islands.\n\
+                        Default: 0 (disabled)\n\n\
+    -D              Keep the population diverse: offspring that duplicate a tour\n\
+                    already in the island (including rotated or reversed copies)\n\
+                    are mutated again before evaluation. Statistics also show the\n\
+                    percentage of distinct tours (D), the edge entropy (H), 0 for\n\
+                    a converged population and 1 for no shared edges, and the\n\
+                    offspring rejected as clones since the previous line (R),\n\
+                    or over the whole run on the final line of all islands.\n\n\
     -e [0-100]      Affects display of generation statistics, shows fitness of\n\
                     top percentage of solutions.\n\
                         Default: 5\n\n\
+    -E [target]     Stream events while evolving: every new best tour, in TSPLIB\n\
+                    tour format, and a statistics line per island every -i\n\
+                    generations. The target is a file or named pipe, or a Unix\n\
+                    socket given as 'unix:<path>'. Events are written by a\n\
+                    background thread, so a slow reader never stalls evolution.\n\
+                    With MPI only the master's island is reported. Ignored with -x.\n\n\
     -f [filename]   Load TSP from the given file. Must be TSPLIB format.\n\
                     Will exclude duplicates.\n\n\
+    -F [integer]    Every this many generations, once the best tour improved by less\n\
+                    than 1%% since the previous time, fix the edges shared by the\n\
+                    elite tours (-e) of every island: the paths they form become\n\
+                    single nodes that may be walked either way, and the population\n\
+                    evolves tours of the remaining nodes, so converged parts of the\n\
+                    tour cost nothing. Checked every -i generations or when islands\n\
+                    cross. Printed and streamed tours are expanded back to cities.\n\
+                    Ignored with MPI and -x.\n\
+                        Default: 0 (disabled)\n\n\
     -g [integer]    Number of generations to evolve.\n\
                         Default: 3000\n\n\
     -h              Display this help.\n\n\
+    -H              Renumber the cities along a Hilbert curve when loading, so that\n\
+                    cities close to each other are close in memory and good tours\n\
+                    walk the coordinates mostly in order. Printed and streamed\n\
+                    tours, and -w tours, keep the file's numbering. Ignored with -B.\n\n\
     -i [integer]    Number of generations between statistics prints. The\n\
                     population is sorted by fitness to find this information, which\n\
                     randomly affects tournament selection.\n\
@@ -96,81 +240,231 @@ Usage: %s [options] <file.tsp>\n\
                     -1 to disable all output.\n\
                     0 to disable printing info before the algorithm finishes.\n\
                         Default: 100\n\n\
+    -I [filename]   Give islands their own parameters: every line of the file names\n\
+                    a profile and sets some of the -k, -m, -M and -p options, as in\n\
+                    'explore -k 2 -m 20000 -M segment', -p being the island's own\n\
+                    population. '-X ils' makes the island run iterated local search\n\
+                    (2-opt and Or-opt with double bridge kicks) on its best tour\n\
+                    instead of evolving, putting the result in place of its worst\n\
+                    tour, and '-X ga' evolves it as usual. Islands take the\n\
+                    profiles in order, as many islands as profiles unless -t is\n\
+                    given. Island statistics show their profile (P), and at the end\n\
+                    every profile's share of the best -e percent of the population\n\
+                    and of the best tours when islands cross. Overrides -T.\n\n\
     -k [integer]    Number of individuals per tournament. Every tournament\n\
                     selects one parent and one individual to be replaced by\n\
                     offspring, so they are held in pairs.\n\
                         Default: 4\n\n\
     -l [filename]   Load TSP from the given file. Must be TSPLIB format. Unlike -f\n\
                     it will keep all duplicates. Can be used implicitly.\n\n\
+    -L [percent]    Compute a Held-Karp lower bound on a background thread while\n\
+                    evolving, and show it and the gap of the best tour to it in the\n\
+                    statistics (LB). Above 0, evolution stops once the gap is at most\n\
+                    this percentage, checked every -i generations or when islands\n\
+                    cross. 0 only reports. Ignored with -x.\n\n\
     -m [integer]    Mutation rate out of 0x0FFFFF, or 1024x1024-1.\n\
                     Default: 1000 (~0.1%)\n\n\
-    -o [filename]   Output generation info to a CSV file.\n\n\
+    -M [operator]   Mutation operator. 'swap' exchanges 2 or 3 genes, 'segment'\n\
+                    moves short paths (Or-opt) and applies double-bridge kicks.\n\
+                        Default: swap\n\n\
+    -N              Pin every island's thread to its own core and place the island's\n\
+                    solutions in memory local to that core's NUMA node, on huge\n\
+                    pages when available. The placement is printed at the start.\n\
+                    Ignored with MPI, where each island is already a process.\n\n\
+    -o [filename]   Output generation info to a CSV file. Ignored with -x.\n\n\
+    -O [filename]   Output every decision of -A to a CSV file, whatever -i is: the\n\
+                    island (-1 when all cross), generation, success rate, and the\n\
+                    mutation rate, tournament size and operator before and after.\n\n\
     -p [integer]    Total population size. If there are more than one island this\n\
                     population is divided evenly among them.\n\
                         Default: 2500\n\n\
+    -P [filename]   Output per-island, per-epoch operator counts and timings to a\n\
+                    CSV file. Only available when compiled with -DPROF.\n\n\
     -r [integer]    Supply a seed to the random number generator.\n\
                     Default: 1\n\n\
+    -R [precision]  Coordinates the fitness reads. 'float' and 'fixed' (32-bit\n\
+                    integers in decimal units) take half the memory of 'double'\n\
+                    and are used only if every rounded distance stays the same:\n\
+                    exactly for float and integer coordinates, otherwise checked\n\
+                    on every city's nearest neighbors and random edges, falling\n\
+                    back to double. 'auto' tries float, then fixed. The mode and\n\
+                    the fitness throughput with it and with doubles are printed.\n\
+                        Default: auto\n\n\
     -t [integer]    Number of islands, each of which is handled by a thread.\n\
                         Default: 1\n\n\
+    -T, --auto      Configure the islands for this machine and instance: probe the\n\
+                    cores, caches and NUMA nodes, time a few seconds of evolution\n\
+                    with one island per core at growing island sizes whose tours\n\
+                    fit in the island's share of L2 or L3 cache, and use the size\n\
+                    with the most offspring per second (larger islands win within\n\
+                    10%%), keeping at least the -p population and noting when it\n\
+                    grows a given -p. Overrides -t, -p and -u, and prints the\n\
+                    chosen values to pin them later.\n\
+                    Ignored with MPI, -B and -x.\n\n\
     -u [integer]    Number of generations after which islands will have their\n\
                     populations crossed.\n\
                     If the interval is below 1, the populations will never cross.\n\
-                        Default: 0\n\n";
+                        Default: 0\n\n\
+    -U              Balance the islands: at every crossing, time each island and\n\
+                    move solutions from the slower islands to the faster ones, so\n\
+                    that all reach the next crossing together on uneven or busy\n\
+                    cores. Needs -t and -u, sizes set by -I are only the starting\n\
+                    ones. Not available with MPI.\n\n\
+    -w [filename]   Start from a known tour, as a TSPLIB .tour file or a binary tour\n\
+                    (the cities' 32-bit indices from 0, as stored in chromosomes).\n\
+                    Can be given more than once. Each island gets every tour once\n\
+                    and copies perturbed by double-bridge kicks. Ignored with -x.\n\n\
+    -W [0-100]      Percentage of each island started from the -w tours.\n\
+                        Default: 10\n\n\
+    -x [integer]    Decompose the instance: split the cities into geometric\n\
+                    clusters of about this size, evolve each cluster as its own\n\
+                    population of the given size, using as many threads as islands,\n\
+                    then join the cluster tours and improve the junctions with 2-opt.\n\
+                    Memory only grows with the cluster size, for very large\n\
+                    instances. Not available with MPI.\n\
+                        Default: 0 (disabled)\n\n\
+    -Z              Store every tour as the edges in which it differs from its\n\
+                    island's reference tour, the island's best tour every 20\n\
+                    generations and at every crossing, and unpack tours only while\n\
+                    operators use them. Converged islands take a fraction of the\n\
+                    memory, and of the bytes sent with MPI, for the cost of packing\n\
+                    every offspring. Ignores -b, -F and -N.\n\n";
 
     printf(help_text, argv[0]);
 }
 
 void parse_args(int argc, char **argv)
 {
-    const char *optstring = "ae:f:g:hi:k:l:m:o:p:r:t:u:";
+    const char *optstring = "aA:b:B:C:De:E:f:F:g:hHi:I:k:l:L:m:M:No:O:p:P:r:R:t:Tu:Uw:W:x:Z";
+    const struct option longopts[] = {
+        { "auto", no_argument, NULL, 'T' },
+        { NULL, 0, NULL, 0 }
+    };
     int opt = 0;
 
-    while ((opt = getopt(argc, argv, optstring)) != -1)
+    while ((opt = getopt_long(argc, argv, optstring, longopts, NULL)) != -1)
     {
         switch (opt)
         {
             case 'a':
                 f_answer = 1;
                 break;
+            case 'A':
+                adapt_window = atoi(optarg);
+                break;
+            case 'b':
+                island_workers = atoi(optarg);
+                break;
+            case 'B':
+                batch_manifest = optarg;
+                break;
+            case 'C':
+                cache_entries = atoi(optarg);
+                break;
+            case 'D':
+                diversity = 1;
+                break;
             case 'e':
                 percent_elite = atoi(optarg);
                 break;
+            case 'E':
+                events_target = optarg;
+                break;
             case 'f':
                 tsp = tsp_2d_read_dedup(optarg);
                 break;
+            case 'F':
+                backbone_interval = atoi(optarg);
+                break;
             case 'g':
                 max_gens = atoi(optarg);
                 break;
             case 'h':
                 print_help(argv);
                 exit(EXIT_SUCCESS);
+            case 'H':
+                hilbert = 1;
+                break;
             case 'i':
                 gen_info_interval = atoi(optarg);
                 break;
+            case 'I':
+                profile_file = optarg;
+                break;
             case 'k':
                 tournament_size = atoi(optarg);
                 break;
             case 'l':
                 tsp = tsp_2d_read(optarg);
                 break;
+            case 'L':
+                gap_target = atof(optarg);
+                break;
             case 'm':
                 mutations = atoi(optarg);
                 break;
+            case 'M':
+                mutation_op = tsp_mutation_find(optarg);
+                if (mutation_op < 0)
+                {
+                    fprintf(stderr, "Unknown mutation operator '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'N':
+                numa_local = 1;
+                break;
             case 'o':
                 csv = fopen(optarg, "wt");
                 break;
+            case 'O':
+                decisions_filename = optarg;
+                break;
             case 'p':
                 population_size = atoi(optarg);
+                population_given = 1;
+                break;
+            case 'P':
+                prof_filename = optarg;
                 break;
             case 'r':
                 srand(atoi(optarg));
                 break;
+            case 'R':
+                if (strcmp(optarg, "auto") == 0)
+                    coord_mode = -1;
+                else if ((coord_mode = coords_find(optarg)) < 0)
+                {
+                    fprintf(stderr, "Unknown coordinate precision '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 't':
                 num_threads = atoi(optarg);
+                threads_given = 1;
+                break;
+            case 'T':
+                auto_tune = 1;
                 break;
             case 'u':
                 island_cross_interval = atoi(optarg);
                 break;
+            case 'U':
+                balance = 1;
+                break;
+            case 'w':
+                warm_files = (char **) realloc(warm_files, sizeof(char *) * (warm_count + 1));
+                warm_files[warm_count++] = optarg;
+                break;
+            case 'W':
+                percent_warm = atoi(optarg);
+                break;
+            case 'x':
+                decomp_size = atoi(optarg);
+                break;
+            case 'Z':
+                packed = 1;
+                break;
             default:
                 fprintf(stderr, "Usage: '%s [options] <file.tsp>'\nSee '%s -h' for help\n", argv[0], argv[0]);
                 exit(EXIT_FAILURE);
@@ -178,32 +472,215 @@ void parse_args(int argc, char **argv)
     }
 }
 
+// Reports island t's best tour if it is the shortest yet, and its statistics every
+// gen_info_interval generations, t being -1 for the whole population when islands cross.
+// Scans the population instead of sorting it like gen_info
+void report_events(ga_solution_t *pop, size_t size, int t, int gen)
+{
+    size_t best = 0;
+    int64_t sum = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        sum += fitness(&pop[i]);
+        if (pop[i].fitness < pop[best].fitness)
+            best = i;
+    }
+    if (backbone.nodes && pop[best].fitness < events_shortest())
+    {
+        uint32_t *cities = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+        backbone_expand(&backbone, &tsp, (uint32_t *) pop[best].chromosome, cities);
+        events_best(cities, pop[best].fitness, gen);
+        free(cities);
+    }
+    else if (!backbone.nodes)
+    {
+        events_best(tsp_tour(&pop[best], 0), pop[best].fitness, gen);
+        tsp_pack_flush();
+    }
+    if (gen_info_interval > 0 && gen % gen_info_interval == 0)
+        events_stats(t, gen, pop[best].fitness, sum / (int64_t) size);
+}
+
+// Creates the random population of -Z, the solutions of island i in [bounds[i], bounds[i + 1])
+// being packed against its first tour
+void pack_population(ga_solution_t *pop, int islands, const int *bounds)
+{
+    pack_init(&pack, tsp.dim, islands);
+    uint32_t *tour = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+    for (int i = 0; i < islands; i++)
+        for (int j = bounds[i]; j < bounds[i + 1]; j++)
+        {
+            ga_init(&pop[j], 1, tsp.dim, sizeof(uint32_t), tour, generate_tsp_solution);
+            pop[j].chromosome = NULL;
+            if (j == bounds[i])
+                pack_reference(&pack, i, tour);
+            pack_store(&pack, &pop[j], i, tour);
+        }
+    free(tour);
+    tsp_default.pack = &pack;
+}
+
+// Makes the best tour of island t, pop, its reference and packs the island against it. Tours
+// drift from the reference as the island evolves, and are packed whole once too far from it
+void rebase_island(ga_solution_t *pop, size_t size, int t)
+{
+    size_t best = 0;
+    for (size_t i = 1; i < size; i++)
+        if (fitness(&pop[i]) < fitness(&pop[best]))
+            best = i;
+    uint32_t *tour = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+    pack_load(&pack, &pop[best], tour);
+    pack_rebase(&pack, t, pop, size, tour);
+    free(tour);
+}
+
+// Rebases every island on its best tour at once, after the crossing sorted solutions into other
+// islands or -U moved the bounds between them
+void rebase_islands(ga_solution_t *population)
+{
+    if (!pack.tours)
+        return;
+    uint32_t *tours = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim * num_threads);
+    for (int i = 0; i < num_threads; i++)
+    {
+        int best = thread_bounds[i];
+        for (int j = thread_bounds[i] + 1; j < thread_bounds[i + 1]; j++)
+            if (fitness(&population[j]) < fitness(&population[best]))
+                best = j;
+        pack_load(&pack, &population[best], tours + i * tsp.dim);
+    }
+    pack_rebase_all(&pack, population, thread_bounds, tours);
+    free(tours);
+}
+
+// Evolves island t's population pop by one generation with the island's current parameters,
+// adapting them at the end of every window. ext and ad belong to the island, or to the main
+// thread for the whole population
+int next_generation(ga_solution_t *pop, size_t size, int t, ga_ext_t *ext, adapt_t *ad)
+{
+    int gen;
+    if (pools)
+        gen = ga_next_generation_batch(pop, size, ad->k, GA_MINIMIZE, fitness, tsp_crossover_ops[ad->arm], ad->mutation_per_Mi, tsp_mutation_ops[ad->arm], pools[t], &worker_rbufs[t * island_workers]);
+    else
+    {
+        gen = tsp_engines[ad->arm](pop, size, ad->k, ad->mutation_per_Mi, &rbufs[t], ext);
+        if (adapt_window > 0 && gen % adapt_window == 0)
+        {
+            int64_t best = fitness(&pop[0]);
+            for (size_t i = 1; i < size; i++)
+                if (fitness(&pop[i]) < best)
+                    best = pop[i].fitness;
+            adapt_t before = *ad;
+            adapt_update(ad, ext->offspring, ext->improved, best, GA_MINIMIZE);
+            int island = num_threads > 1 && ext == &exts[num_threads] ? -1 : island_base + t;
+            if (decisions && ad->decisions != before.decisions)
+                fprintf(decisions, "%d,%d,%.2f,%d,%d,%d,%d,%s,%s\n", island, gen, 100 * ad->success,
+                        before.mutation_per_Mi, ad->mutation_per_Mi, before.k, ad->k,
+                        tsp_mutation_names[before.arm], tsp_mutation_names[ad->arm]);
+            if (gen_info_interval > 0 && ad->decisions != before.decisions)
+                printf("Adapt\tI: %3d\tG: %6d:\tS: %4.1f%%\tm: %d -> %d\tk: %d -> %d\t%s -> %s\n",
+                       island, gen, 100 * ad->success,
+                       before.mutation_per_Mi, ad->mutation_per_Mi, before.k, ad->k,
+                       tsp_mutation_names[before.arm], tsp_mutation_names[ad->arm]);
+        }
+    }
+    // The crossing of all islands leaves them to rebase_islands
+    if (pack.tours && !(num_threads > 1 && ext == &exts[num_threads]) && gen % PACK_REBASE == 0)
+        rebase_island(pop, size, t);
+    if (events_target)
+        report_events(pop, size, num_threads > 1 && ext == &exts[num_threads] ? -1 : t, gen);
+    return gen;
+}
+
+// Opens the adaptation decisions CSV one line per write, so processes appending to it don't mix
+// lines. The master truncates it and writes the header before sending the MPI slaves their
+// islands, the slaves append to it. Returns 0 if it could not be opened
+int open_decisions(int master)
+{
+    decisions = fopen(decisions_filename, master ? "wt" : "at");
+    if (!decisions)
+        return 0;
+    setvbuf(decisions, NULL, _IOLBF, 0);
+    if (master)
+        fprintf(decisions, "Island,Generation,Success%%,Mutation,NewMutation,Tournament,NewTournament,Operator,NewOperator\n");
+    return 1;
+}
+
+// Profile of island i, NULL without -I
+profile_t *island_profile(int i)
+{
+    return profiles ? &profiles[i % profile_count] : NULL;
+}
+
+// Runs iterated local search on the best tour of island t for as many kicks as its tournaments
+// would create offspring in gens generations, and puts the result in place of its worst solution
+int ils_island(ga_solution_t *pop, size_t size, int t, int gens, int k)
+{
+    size_t best = 0, worst = 0;
+    fitness(&pop[0]);
+    for (size_t i = 1; i < size; i++)
+    {
+        if (fitness(&pop[i]) < pop[best].fitness)
+            best = i;
+        if (pop[i].fitness > pop[worst].fitness)
+            worst = i;
+    }
+
+    uint32_t *tour = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+    if (backbone.nodes)
+        backbone_expand(&backbone, &tsp, (uint32_t *) pop[best].chromosome, tour);
+    else
+        memcpy(tour, tsp_tour(&pop[best], 0), sizeof(uint32_t) * tsp.dim);
+    ils_run(&ils, tour, (long) gens * size / (k < 2 ? 2 : k), &rbufs[t]);
+    if (backbone.nodes)
+        backbone_compress(&backbone, tour, (uint32_t *) pop[worst].chromosome);
+    else
+        memcpy(tsp_tour(&pop[worst], 1), tour, sizeof(uint32_t) * tsp.dim);
+    tsp_pack_flush();
+    pop[worst].fit_gen = 0;
+    pop[worst].hash = 0;
+    free(tour);
+
+    int gen = 0;
+    for (size_t i = 0; i < size; i++)
+        gen = pop[i].generation += gens;
+    if (events_target)
+        report_events(pop, size, t, gen);
+    return gen;
+}
+
 int serial_ga(ga_solution_t *population, int gens)
 {
     int gen = population->generation;
+    // A single island may be an ILS one, several islands cross here as a whole
+    profile_t *p = num_threads <= 1 ? island_profile(0) : NULL;
+    if (p && p->worker == PROFILE_ILS)
+        return ils_island(population, population_size, 0, gens, p->k);
     while (gens-- > 0)
     {
         if (sel_strat == SEL_TOURNAMENT)
             /* Do tournaments to define which solutions are selected to cross.
             If the percentage dead is half or more, all individuals reproduce.
             The strongest solution stays in the population if it is not topped.*/
-            gen = ga_next_generation_tournament(population, population_size, tournament_size, GA_MINIMIZE, fitness, crossover, mutations, mutate, &rbufs[0]);
+            gen = next_generation(population, population_size, 0, &exts[num_threads], &adapts[num_threads]);
     }
 
     return gen;
 }
 
 #ifdef MPI
-int mpi_ga(ga_solution_t *population, int gens, int island_size)
+int mpi_ga(ga_solution_t *population, int gens, int island_size, profile_t *p)
 {
     int gen = population->generation;
+    if (p && p->worker == PROFILE_ILS)
+        return ils_island(population, island_size, 0, gens, p->k);
     while (gens-- > 0)
     {
         if (sel_strat == SEL_TOURNAMENT)
             /* Do tournaments to define which solutions are selected to cross.
             If the percentage dead is half or more, all individuals reproduce.
             The strongest solution stays in the population if it is not topped.*/
-            gen = ga_next_generation_tournament(population, island_size, tournament_size, GA_MINIMIZE, fitness, crossover, mutations, mutate, &rbufs[0]);
+            gen = next_generation(population, island_size, 0, &exts[0], &adapts[0]);
     }
 
     return gen;
@@ -213,30 +690,473 @@ int mpi_ga(ga_solution_t *population, int gens, int island_size)
 struct parallel_ga_arg {
     ga_solution_t *population;
     int gens, low, high, t;
+    double seconds;             // the island took to evolve, for -U
 };
 
 // Executes GA in parallel for a chunk of population, defined by the indices in the range [low, high)
 void *parallel_ga(void *_arg)
 {
     struct parallel_ga_arg arg = *(struct parallel_ga_arg *) _arg;
+    PROF_SET_TID(arg.t);
+    if (island_cpus)
+        arena_pin(island_cpus[arg.t]);
     // struct drand48_data rd;
     // srand48_r(arg.population->generation + arg.low, &rd);
-    while (arg.gens-- > 0)
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    profile_t *p = island_profile(arg.t);
+    if (p && p->worker == PROFILE_ILS)
+        ils_island(arg.population + arg.low, arg.high - arg.low, arg.t, arg.gens, p->k);
+    else
+        while (arg.gens-- > 0)
+        {
+            if (sel_strat == SEL_TOURNAMENT)
+                /* Do tournaments to define which solutions are selected to cross.
+                If the percentage dead is half or more, all individuals reproduce.
+                The strongest solution stays in the population if it is not topped.*/
+                next_generation(arg.population + arg.low, arg.high - arg.low, arg.t, &exts[arg.t], &adapts[arg.t]);
+        }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ((struct parallel_ga_arg *) _arg)->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    return NULL;
+}
+
+// Moves the bounds between islands so that each gets a population proportional to its speed in
+// the epoch args timed. Solutions at the bounds change island, as the crossing mixes them anyway
+void balance_islands(const struct parallel_ga_arg *args)
+{
+    int *sizes = (int *) malloc(sizeof(int) * num_threads);
+    double *seconds = (double *) malloc(sizeof(double) * num_threads);
+    int k = 2;
+    for (int i = 0; i < num_threads; i++)
     {
-        if (sel_strat == SEL_TOURNAMENT)
-            /* Do tournaments to define which solutions are selected to cross.
-            If the percentage dead is half or more, all individuals reproduce.
-            The strongest solution stays in the population if it is not topped.*/
-            ga_next_generation_tournament(arg.population + arg.low, arg.high - arg.low, tournament_size, GA_MINIMIZE, fitness, crossover, mutations, mutate, &rbufs[arg.t]);
+        sizes[i] = thread_bounds[i + 1] - thread_bounds[i];
+        seconds[i] = args[i].seconds;
+        k = adapts[i].k_max > k ? adapts[i].k_max : k;
     }
 
-    return NULL;
+    // Islands keep enough solutions for a few tournaments
+    if (balance_sizes(num_threads, sizes, seconds, 2 * k))
+    {
+        for (int i = 0; i < num_threads; i++)
+            thread_bounds[i + 1] = thread_bounds[i] + sizes[i];
+        if (gen_info_interval > 0)
+        {
+            printf("Balance: times");
+            for (int i = 0; i < num_threads; i++)
+                printf(" %.3f", seconds[i]);
+            printf(" s, sizes");
+            for (int i = 0; i < num_threads; i++)
+                printf(" %d", sizes[i]);
+            printf("\n");
+        }
+    }
+    free(seconds);
+    free(sizes);
+}
+
+// Evolves one cluster of a decomposed instance on the calling thread and writes its best tour
+void solve_cluster_ga(const tsp_2d_t *sub, uint32_t *tour, int cluster, int worker, void *arg)
+{
+    struct drand48_data rbuf;
+    srand48_r(*(long *) arg + cluster, &rbuf);
+    tsp_context_t ctx = { .instance = sub, .rbuf = &rbuf, .mutations = mutations };
+    tsp_set_local(&ctx);
+
+    uint32_t *chunk = (uint32_t *) malloc(sizeof(uint32_t) * sub->dim * population_size);
+    ga_solution_t *pop = (ga_solution_t *) malloc(sizeof(ga_solution_t) * population_size);
+    ga_init(pop, population_size, sub->dim, sizeof(uint32_t), chunk, generate_tsp_solution);
+
+    for (int gen = 0; gen < max_gens; gen++)
+        tsp_engines[mutation_op](pop, population_size, tournament_size, mutations, &rbuf, NULL);
+
+    int best = 0;
+    for (int i = 1; i < population_size; i++)
+        if (fitness(&pop[i]) < fitness(&pop[best]))
+            best = i;
+    memcpy(tour, pop[best].chromosome, sizeof(uint32_t) * sub->dim);
+    if (gen_info_interval >= 0)
+        printf("Cluster %4d:\tN: %5lu\tB: %6ld\n", cluster, sub->dim, pop[best].fitness);
+
+    free(pop);
+    free(chunk);
+    tsp_set_local(NULL);
+}
+
+// Solves the whole instance in clusters instead of evolving full tours
+void decompose()
+{
+    long seed = rand();
+    pool_t *pool = pool_create(num_threads, 0);
+    uint32_t *tour = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+
+    decomp_stats_t stats = decomp_solve(&tsp, decomp_size, DECOMP_WINDOW, pool, solve_cluster_ga, &seed, tour);
+    pool_destroy(pool);
+
+    if (gen_info_interval >= 0)
+    {
+        printf("\nClusters: %d, largest: %lu\n", stats.clusters, stats.largest);
+        printf("Joined: %ld\tJunctions improved: %ld\n", stats.stitched, stats.refined);
+    }
+
+    if (f_answer)
+    {
+        printf("\nBest path after %d generations: %lu\n", max_gens, stats.refined);
+        for (int i = 0; i < tsp.dim; i++)
+            printf("%s%u ", (i) ? "-> " : "", city_ids ? city_ids[tour[i]] : tour[i]);
+        printf("\n");
+    }
+    free(tour);
+}
+
+// Returns 1 if the best tour is within gap_target percent of the lower bound, and makes gen the
+// last generation
+int gap_reached(ga_solution_t *population, int gen)
+{
+    int64_t lb = bound_get();
+    if (gap_target <= 0 || lb <= 0)
+        return 0;
+
+    int64_t best = fitness(&population[0]);
+    for (int i = 1; i < population_size; i++)
+        if (fitness(&population[i]) < best)
+            best = population[i].fitness;
+    if (100.0 * (best - lb) > gap_target * lb)
+        return 0;
+
+    if (gen_info_interval >= 0)
+        printf("Gap to the lower bound %ld at most %g%%, stopping at generation %d\n", lb, gap_target, gen);
+    max_gens = gen;
+    return 1;
+}
+
+// Every backbone_interval generations, once the best tour improves by less than BACKBONE_STALL
+// percent per interval, fixes the edges shared by the elite tours of every island and rewrites
+// every chromosome as a tour of the new backbone's nodes. Fixing earlier would freeze the edges
+// of tours that are still far from good, since tournament selection makes elites alike quickly
+void fix_backbone(ga_solution_t *population, int gen)
+{
+    if (backbone_interval <= 0 || gen - backbone_gen < backbone_interval)
+        return;
+    backbone_gen = gen;
+
+    int64_t best = fitness(&population[0]);
+    for (int i = 1; i < population_size; i++)
+        if (fitness(&population[i]) < best)
+            best = population[i].fitness;
+    int64_t last = backbone_best;
+    backbone_best = best;
+    if (!last || 100 * (last - best) >= BACKBONE_STALL * last)
+        return;
+
+    // Elites of every island as city tours
+    int n = 0;
+    uint32_t **elites = (uint32_t **) calloc(population_size, sizeof(uint32_t *));
+    for (int i = 0; i < num_threads; i++)
+    {
+        int low = thread_bounds[i], size = thread_bounds[i + 1] - low;
+        ga_select_trunc(population + low, size, GA_MINIMIZE, percent_dead, percent_elite, fitness);
+        int e = size * percent_elite / 100;
+        for (int j = 0; j < (e > 2 ? e : 2) && j < size; j++)
+        {
+            elites[n] = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+            if (backbone.nodes)
+                backbone_expand(&backbone, &tsp, (uint32_t *) population[low + j].chromosome, elites[n]);
+            else
+                memcpy(elites[n], population[low + j].chromosome, sizeof(uint32_t) * tsp.dim);
+            n++;
+        }
+    }
+
+    backbone_t next;
+    size_t nodes = backbone_fix(&backbone, &tsp, elites, n, 8, &next);
+    for (int i = 0; i < n; i++)
+        free(elites[i]);
+    free(elites);
+    if (!nodes)
+        return;
+
+    uint32_t *cities = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+    for (int i = 0; i < population_size; i++)
+    {
+        ga_solution_t *sol = &population[i];
+        if (backbone.nodes)
+            backbone_expand(&backbone, &tsp, (uint32_t *) sol->chromosome, cities);
+        else
+            memcpy(cities, sol->chromosome, sizeof(uint32_t) * tsp.dim);
+        backbone_compress(&next, cities, (uint32_t *) sol->chromosome);
+        sol->chrom_len = nodes;
+        sol->fit_gen = 0;
+        sol->hash = 0;
+    }
+    free(cities);
+
+    backbone_free(&backbone);
+    backbone = next;
+    tsp_default.backbone = &backbone;
+    // Hashes of node tours no longer identify the same city tours
+    if (caches)
+        for (int i = 0; i < (cache_entries < 0 ? 1 : num_threads + 1); i++)
+            fcache_clear(&caches[i]);
+
+    if (gen_info_interval >= 0)
+        printf("Backbone: %lu of %lu edges shared by %d elite tours, %lu nodes left\n", backbone.fixed, tsp.dim, n, nodes);
+}
+
+// Prints the reduced precision coordinates that keep the distances, whether they are in use,
+// and the fitness throughput with them and with doubles
+void report_coords()
+{
+    if (!coords.rate)
+    {
+        coords_t ref = { .tsp = &tsp, .mode = COORDS_DOUBLE };
+        coords.rate = coords_rate(&coords, COORDS_SECONDS);
+        coords.double_rate = coords_rate(&ref, COORDS_SECONDS);
+    }
+    if (coords.candidate == COORDS_FIXED)
+        printf("Coordinates: fixed point with %d decimals", coords.digits);
+    else
+        printf("Coordinates: float");
+    if (coords.exact)
+        printf(", exact");
+    else
+        printf(", %lu candidate edges checked", coords.checked);
+    printf(coords.mode == COORDS_DOUBLE ? ", slower than doubles\n" : "\n");
+    printf("Fitness: %.1f M cities/s, %.1f M cities/s with doubles\n\n", coords.rate / 1e6, coords.double_rate / 1e6);
+}
+
+// Measures the best tour again with doubles, which only differs if reduced precision coordinates
+// changed the rounding of an edge no check covered
+void check_coords(ga_solution_t *population)
+{
+    if (coords.mode == COORDS_DOUBLE || backbone.nodes)
+        return;
+    size_t best = 0;
+    for (size_t i = 1; i < population_size; i++)
+        if (fitness(&population[i]) < fitness(&population[best]))
+            best = i;
+    coords_t ref = { .tsp = &tsp, .mode = COORDS_DOUBLE };
+    int64_t len = coords_length(&ref, tsp_tour(&population[best], 0), tsp.dim);
+    tsp_pack_flush();
+    if (len != population[best].fitness)
+        fprintf(stderr, "Note: the best tour is %ld long with doubles, %ld with -R %s\n", len, population[best].fitness, coords_names[coords.mode]);
 }
 
-void gen_info(ga_solution_t *pop, int island)
+// Seeds every island with the -w tours. Exits if one can't be read
+void warm_start(ga_solution_t *population)
+{
+    uint32_t **tours = (uint32_t **) malloc(sizeof(uint32_t *) * warm_count);
+    for (int i = 0; i < warm_count; i++)
+    {
+        tours[i] = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+        if (tsp_tour_read(warm_files[i], tsp.dim, tours[i]) < 0)
+        {
+            fprintf(stderr, "Could not read a tour of %lu cities from '%s'\n", tsp.dim, warm_files[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Files use the original numbering
+    if (city_ids)
+    {
+        uint32_t *index = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+        for (uint32_t c = 0; c < tsp.dim; c++)
+            index[city_ids[c]] = c;
+        for (int i = 0; i < warm_count; i++)
+            for (size_t j = 0; j < tsp.dim; j++)
+                tours[i][j] = index[tours[i][j]];
+        free(index);
+    }
+
+    for (int i = 0; i < num_threads; i++)
+        tsp_seed_population(population + thread_bounds[i], thread_bounds[i + 1] - thread_bounds[i], tours, warm_count, percent_warm, &rbufs[0]);
+
+    for (int i = 0; i < warm_count; i++)
+        free(tours[i]);
+    free(tours);
+}
+
+// Maps the chromosomes and solutions with each island's part first touched from the core its
+// thread is pinned to, so that the pages are placed on that core's NUMA node
+void place_islands(uint32_t **chromosome_chunk, ga_solution_t **population)
+{
+    island_cpus = (int *) malloc(sizeof(int) * num_threads);
+    for (int i = 0; i < num_threads; i++)
+        island_cpus[i] = arena_island_cpu(i, num_threads);
+
+    *chromosome_chunk = (uint32_t *) arena_map(&arenas[0], sizeof(uint32_t) * tsp.dim * population_size);
+    *population = (ga_solution_t *) arena_map(&arenas[1], sizeof(ga_solution_t) * population_size);
+    if (!*chromosome_chunk || !*population)
+    {
+        fprintf(stderr, "Could not map the population\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        size_t low = thread_bounds[i], n = thread_bounds[i + 1] - low;
+        int pinned = arena_touch(*chromosome_chunk + low * tsp.dim, sizeof(uint32_t) * tsp.dim * n, island_cpus[i]);
+        arena_touch(*population + low, sizeof(ga_solution_t) * n, island_cpus[i]);
+        if (gen_info_interval >= 0)
+            printf("Island %d: CPU %d%s, node %d, %s pages\n", i, island_cpus[i], pinned ? "" : " (not pinned)",
+                   arena_node(*chromosome_chunk + low * tsp.dim), arena_pages_name(arenas[0].pages));
+    }
+
+    // A single island runs on the main thread
+    if (num_threads == 1)
+        arena_pin(island_cpus[0]);
+}
+
+// Reads the -I profiles, sets the number of islands if -t didn't and the population of every
+// island. Exits if the file can't be read
+void load_profiles()
+{
+    profile_t defaults = { .k = tournament_size, .mutations = mutations, .op = mutation_op };
+    profile_count = profile_load(profile_file, defaults, &profiles);
+    if (profile_count < 1)
+    {
+        fprintf(stderr, "Could not read island profiles from '%s'\n", profile_file);
+        exit(EXIT_FAILURE);
+    }
+    if (!threads_given)
+        num_threads = profile_count;
+
+    int total = 0;
+    island_sizes = (int *) malloc(sizeof(int) * num_threads);
+    for (int i = 0; i < num_threads; i++)
+    {
+        profile_t *p = island_profile(i);
+        island_sizes[i] = p->size ? p->size : population_size / num_threads;
+        total += island_sizes[i];
+        p->islands++;
+    }
+    population_size = total;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// Before islands cross, credits the profile of the island holding the best tour with a win, and
+// every profile with its islands' solutions among the best percent_elite of the population
+void score_profiles(ga_solution_t *population)
+{
+    int64_t *sorted = (int64_t *) malloc(sizeof(int64_t) * population_size);
+    int best = 0;
+    for (int i = 0; i < population_size; i++)
+    {
+        sorted[i] = fitness(&population[i]);
+        if (sorted[i] < sorted[best])
+            best = i;
+    }
+    qsort(sorted, population_size, sizeof(int64_t), cmp_int64);
+    int e = population_size * percent_elite / 100;
+    int64_t threshold = sorted[(e > 1 ? e : 1) - 1];
+    free(sorted);
+
+    for (int i = 0; i < profile_count; i++)
+        if (profiles[i].islands)
+            profiles[i].crossings++;
+    for (int i = 0; i < num_threads; i++)
+    {
+        profile_t *p = island_profile(i);
+        if (best >= thread_bounds[i] && best < thread_bounds[i + 1])
+            p->wins++;
+        for (int j = thread_bounds[i]; j < thread_bounds[i + 1]; j++)
+            if (population[j].fitness <= threshold)
+                p->elites++;
+    }
+}
+
+// Prints every profile's share of the elite and of the best tours at the crossings
+void profile_report()
+{
+    unsigned long elites = 0;
+    for (int i = 0; i < profile_count; i++)
+        elites += profiles[i].elites;
+    printf("\nProfile                          Islands  Wins  Win%%  Elite%%\n");
+    for (int i = 0; i < profile_count; i++)
+    {
+        profile_t *p = &profiles[i];
+        printf("%-32s %7lu %5lu %5.1f %6.1f\n", p->name, p->islands, p->wins,
+               p->crossings ? 100.0 * p->wins / p->crossings : 0, elites ? 100.0 * p->elites / elites : 0);
+    }
+}
+
+// Sets up the engine extensions of every island and the main thread
+void init_extensions()
+{
+    exts = (ga_ext_t *) malloc(sizeof(ga_ext_t) * (num_threads + 1));
+    adapts = (adapt_t *) malloc(sizeof(adapt_t) * (num_threads + 1));
+    if (cache_entries)
+    {
+        int shared = cache_entries < 0;
+        caches = (fcache_t *) malloc(sizeof(fcache_t) * (shared ? 1 : num_threads + 1));
+        for (int i = 0; i < (shared ? 1 : num_threads + 1); i++)
+            fcache_init(&caches[i], shared ? -cache_entries : cache_entries, shared);
+    }
+    for (int i = 0; i <= num_threads; i++)
+    {
+        // A single island evolves on the main thread's slot
+        profile_t *p = i < num_threads || num_threads <= 1 ? island_profile(i < num_threads ? i : 0) : NULL;
+        if (p)
+            adapt_init(&adapts[i], p->mutations, p->k, TSP_MUTATIONS, p->op);
+        else
+            adapt_init(&adapts[i], mutations, tournament_size, TSP_MUTATIONS, mutation_op);
+        exts[i] = (ga_ext_t) {0};
+        if (diversity)
+            exts[i] = (ga_ext_t) { .hash_func = tsp_hash, .clone_retries = 3 };
+        if (caches)
+        {
+            exts[i].hash_func = tsp_hash;
+            exts[i].cache = &caches[cache_entries < 0 ? 0 : i];
+        }
+    }
+}
+
+// Starts the offspring workers of every island (only one island per MPI process). Helper
+// threads of island i use the profiling slots after the main thread's
+void init_pools(int islands)
+{
+    if (island_workers <= 1)
+        return;
+    pools = (pool_t **) malloc(sizeof(pool_t *) * islands);
+    worker_rbufs = (struct drand48_data *) malloc(sizeof(struct drand48_data) * islands * island_workers);
+    for (int i = 0; i < islands; i++)
+        pools[i] = pool_create(island_workers, num_threads + 1 + i * (island_workers - 1));
+    for (int i = 0; i < islands * island_workers; i++)
+        srand48_r(rand(), &worker_rbufs[i]);
+}
+
+void free_pools(int islands)
+{
+    if (!pools)
+        return;
+    for (int i = 0; i < islands; i++)
+        pool_destroy(pools[i]);
+    free(pools);
+    free(worker_rbufs);
+}
+
+void free_caches()
+{
+    if (!caches)
+        return;
+    for (int i = 0; i < (cache_entries < 0 ? 1 : num_threads + 1); i++)
+        fcache_free(&caches[i]);
+    free(caches);
+}
+
+// Prints the statistics of island, or of the whole population when num_threads is 0 or 1, with
+// the counters of ext, which are reset, and the parameters of ad, if any
+void gen_info(ga_solution_t *pop, int island, ga_ext_t *ext, const adapt_t *ad)
 {
     int64_t best, worst_elite = 0, avg, worst;
     int gen = pop->generation;
+    PROF_START(t);
     // Just to sort population, doesn't make any changes
     if (num_threads <= 1)
     {
@@ -256,12 +1176,77 @@ void gen_info(ga_solution_t *pop, int island)
             ga_gen_info(pop + thread_bounds[island], thread_bounds[island + 1] - thread_bounds[island], percent_elite, &best, &worst_elite, &avg, &worst);
     }
 
+    // Diversity, and the offspring rejected as clones since the previous statistics of this island
+    char div_info[48] = "";
+    char div_csv[48] = ",,";
+    if (diversity)
+    {
+        ga_solution_t *ipop = (num_threads <= 1) ? pop : pop + thread_bounds[island];
+        size_t isize = (num_threads <= 1) ? population_size : thread_bounds[island + 1] - thread_bounds[island];
+        int distinct = div_distinct_percent(ipop, isize, tsp_hash);
+        double entropy = div_edge_entropy(ipop, isize, tsp_tour);
+        tsp_pack_flush();
+        snprintf(div_info, sizeof(div_info), "\tD: %3d%%\tH: %.3f\tR: %lu", distinct, entropy, ext->clones);
+        snprintf(div_csv, sizeof(div_csv), "%d,%.4f,%lu", distinct, entropy, ext->clones);
+        __atomic_fetch_add(&ext_shown.clones, ext->clones, __ATOMIC_RELAXED);
+        ext->clones = 0;
+    }
+
+    // Hit rate since the previous statistics of this island
+    char cache_info[16] = "";
+    char cache_csv[16] = "";
+    if (ext->cache)
+    {
+        double rate = ext->lookups ? 100.0 * ext->hits / ext->lookups : 0;
+        snprintf(cache_info, sizeof(cache_info), "\tC: %5.1f%%", rate);
+        snprintf(cache_csv, sizeof(cache_csv), "%.2f", rate);
+        __atomic_fetch_add(&ext_shown.lookups, ext->lookups, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&ext_shown.hits, ext->hits, __ATOMIC_RELAXED);
+        ext->lookups = ext->hits = 0;
+    }
+
+    // Parameters in use, none for the whole population of several islands
+    char adapt_info[64] = "";
+    char adapt_csv[64] = ",,,";
+    if (ad)
+        snprintf(adapt_csv, sizeof(adapt_csv), "%d,%d,%s,", ad->mutation_per_Mi, ad->k, tsp_mutation_names[ad->arm]);
+    if (ad && adapt_window > 0)
+    {
+        snprintf(adapt_info, sizeof(adapt_info), "\tm: %d k: %d %s S: %4.1f%%", ad->mutation_per_Mi, ad->k, tsp_mutation_names[ad->arm], 100 * ad->success);
+        snprintf(adapt_csv, sizeof(adapt_csv), "%d,%d,%s,%.2f", ad->mutation_per_Mi, ad->k, tsp_mutation_names[ad->arm], 100 * ad->success);
+    }
+
+    char profile_info[PROFILE_NAME + 8] = "";
+    char profile_csv[PROFILE_NAME] = "";
+    if (profiles && num_threads > 1)
+    {
+        snprintf(profile_info, sizeof(profile_info), "\tP: %s", island_profile(island)->name);
+        snprintf(profile_csv, sizeof(profile_csv), "%s", island_profile(island)->name);
+    }
+
+    // Gap to the lower bound, once there is one
+    char bound_info[40] = "";
+    char bound_csv[40] = ",";
+    int64_t lb = gap_target >= 0 ? bound_get() : 0;
+    if (lb > 0)
+    {
+        snprintf(bound_info, sizeof(bound_info), "\tLB: %ld %5.2f%%", lb, 100.0 * (best - lb) / lb);
+        snprintf(bound_csv, sizeof(bound_csv), "%ld,%.4f", lb, 100.0 * (best - lb) / lb);
+    }
+
+    PROF_STOP(t, PROF_GEN_INFO);
+
     if (csv)
-        fprintf(csv, "%d,%d,%lu,%d,%lu,%lu,%lu\n", island, gen, best, percent_elite, worst_elite, avg, worst);
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double secs = (now.tv_sec - t_start.tv_sec) + (now.tv_nsec - t_start.tv_nsec) * 1e-9;
+        fprintf(csv, "%d,%d,%lu,%d,%lu,%lu,%lu,%.3f,%s,%s,%s,%s,%s\n", island, gen, best, percent_elite, worst_elite, avg, worst, secs, div_csv, cache_csv, adapt_csv, bound_csv, profile_csv);
+    }
     if (num_threads > 1)
-        printf("I: %3d\tG: %6d:\tB: %5lu\t%3d%%: %5lu\tA: %5lu\tW: %5lu\n", island, gen, best, percent_elite, worst_elite, avg, worst);
+        printf("I: %3d\tG: %6d:\tB: %5lu\t%3d%%: %5lu\tA: %5lu\tW: %5lu%s%s%s%s%s\n", island, gen, best, percent_elite, worst_elite, avg, worst, div_info, cache_info, adapt_info, bound_info, profile_info);
     else 
-        printf("G: %6d:\tB: %5lu\t%3d%%: %5lu\tA: %5lu\tW: %5lu\n", gen, best, percent_elite, worst_elite, avg, worst);
+        printf("G: %6d:\tB: %5lu\t%3d%%: %5lu\tA: %5lu\tW: %5lu%s%s%s%s\n", gen, best, percent_elite, worst_elite, avg, worst, div_info, cache_info, adapt_info, bound_info);
 }
 
 #ifdef MPI
@@ -270,9 +1255,12 @@ void gen_info(ga_solution_t *pop, int island)
 
 #define FLAG_TAG  1
 #define DATA_TAG  2
+#define PROF_TAG  3
+#define PRINT_TAG 4
 
 // Send island population's genetic information to the process with ID dest_proc as an array of chars.
-// A flag char is sent first: 0 when pop is NULL, signifies the end of the program, >0 otherwise, pop is sent afterwards.
+// A flag char is sent first: 0 when pop is NULL, signifies the end of the program, >0 otherwise, pop is sent afterwards,
+// followed by the fingerprint of every chromosome so the receiver only needs to fully check those that differ.
 // A 0 flag should only be sent from the master, as slaves have no knowledge of how many generations have passed.
 void send_island(int dest_proc, ga_solution_t *pop, int from, int up_to)
 {
@@ -287,17 +1275,49 @@ void send_island(int dest_proc, ga_solution_t *pop, int from, int up_to)
 
     int proc_id;
     MPI_Comm_rank(MPI_COMM_WORLD, &proc_id);
+    PROF_START(t);
+    tsp_fingerprint_t *prints = (tsp_fingerprint_t *) malloc(sizeof(tsp_fingerprint_t) * (up_to - from));
+    size_t words = 0;
+    if (pack.tours)
+    {
+        // Packed records go as they are, after the reference they are packed against
+        MPI_Send(pack.tours + pack_ref(&pop[from]) * pack.dim, pack.dim, MPI_UINT32_T, dest_proc, DATA_TAG, MPI_COMM_WORLD);
+        words += pack.dim;
+    }
     for (int i = from; i < up_to; i++)
     {
+        if (pack.tours)
+        {
+            prints[i - from] = tsp_fingerprint(pack_peek(&pack, &pop[i]), pop->chrom_len);
+            MPI_Send(((uint32_t*)pop[i].chromosome), pack_words(&pop[i]), MPI_UINT32_T, dest_proc, DATA_TAG, MPI_COMM_WORLD);
+            words += pack_words(&pop[i]);
+            continue;
+        }
+        prints[i - from] = tsp_fingerprint((uint32_t *) pop[i].chromosome, pop->chrom_len);
         MPI_Send(((uint32_t*)pop[i].chromosome), pop->chrom_len, MPI_UINT32_T, dest_proc, DATA_TAG, MPI_COMM_WORLD);
+        words += pop->chrom_len;
     }
+    MPI_Send(prints, sizeof(tsp_fingerprint_t) * (up_to - from), MPI_BYTE, dest_proc, PRINT_TAG, MPI_COMM_WORLD);
+    free(prints);
+    PROF_STOP(t, PROF_TRANSFER);
+    PROF_COUNT(migration_bytes, sizeof(uint32_t) * words);
+
+    #ifdef PROF
+    // Slaves ship their counters back with the island so the master can report them
+    if (prof_slots && proc_id != 0)
+    {
+        MPI_Send(&prof_slots[prof_tid], sizeof(prof_counters_t), MPI_BYTE, dest_proc, PROF_TAG, MPI_COMM_WORLD);
+        memset(&prof_slots[prof_tid], 0, sizeof(prof_counters_t));
+    }
+    #endif
 }
 
 // Receive an island population's genetic information as an array of chars from the process with ID src_proc and
-// store it in the dest array.
+// store it in the dest array. The sender's fingerprints of the chromosomes are stored in sent[from .. up_to), and the
+// fingerprints of what arrived in received[from .. up_to), computed while each chromosome is still in cache.
 // A flag char is received first: 0 signifies the end of the program, >0 signifies that the population is sent next.
 // If a 0 flag is received, the slave will terminate execution
-int receive_island(int src_proc, ga_solution_t *dest, int from, int up_to)
+int receive_island(int src_proc, ga_solution_t *dest, int from, int up_to, tsp_fingerprint_t *sent, tsp_fingerprint_t *received)
 {
     char flag[1] = {FLAG_TERM};
     MPI_Recv(flag, 1, MPI_CHAR, src_proc, FLAG_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
@@ -307,10 +1327,62 @@ int receive_island(int src_proc, ga_solution_t *dest, int from, int up_to)
 
     int proc_id;
     MPI_Comm_rank(MPI_COMM_WORLD, &proc_id);
+    PROF_START(t);
+    size_t words = 0;
+    int r = 0;
+    if (pack.tours)
+    {
+        // The island's records replace all of those packed against its reference
+        uint32_t *tour = (uint32_t *) malloc(sizeof(uint32_t) * pack.dim);
+        MPI_Recv(tour, pack.dim, MPI_UINT32_T, src_proc, DATA_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        r = pack_ref(&dest[from]);
+        pack_reference(&pack, r, tour);
+        free(tour);
+        words += pack.dim;
+    }
     for (int i = from; i < up_to; i++)
     {
-        MPI_Recv(((uint32_t*)dest[i].chromosome), dest->chrom_len, MPI_UINT32_T, src_proc, DATA_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (pack.tours)
+        {
+            // Records vary in length, a malformed one is replaced by the reference
+            MPI_Status status;
+            int count;
+            MPI_Probe(src_proc, DATA_TAG, MPI_COMM_WORLD, &status);
+            MPI_Get_count(&status, MPI_UINT32_T, &count);
+            MPI_Recv(pack_record(&dest[i], count), count, MPI_UINT32_T, src_proc, DATA_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            pack_adopt(&pack, &dest[i], r, count);
+            received[i] = tsp_fingerprint(pack_peek(&pack, &dest[i]), dest->chrom_len);
+            words += count;
+        }
+        else
+        {
+            MPI_Recv(((uint32_t*)dest[i].chromosome), dest->chrom_len, MPI_UINT32_T, src_proc, DATA_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            received[i] = tsp_fingerprint((uint32_t *) dest[i].chromosome, dest->chrom_len);
+            words += dest->chrom_len;
+        }
+        // Cached values belong to the chromosome that was just overwritten
+        dest[i].fit_gen = 0;
+        dest[i].hash = 0;
+    }
+    MPI_Recv(sent + from, sizeof(tsp_fingerprint_t) * (up_to - from), MPI_BYTE, src_proc, PRINT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    PROF_STOP(t, PROF_TRANSFER);
+    PROF_COUNT(migration_bytes, sizeof(uint32_t) * words);
+
+    #ifdef PROF
+    if (prof_slots && proc_id == 0)
+    {
+        prof_counters_t c;
+        MPI_Recv(&c, sizeof(prof_counters_t), MPI_BYTE, src_proc, PROF_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        prof_counters_t *slot = &prof_slots[src_proc - 1];
+        for (int p = 0; p < PROF_PHASES; p++)
+        {
+            slot->ticks[p] += c.ticks[p];
+            slot->calls[p] += c.calls[p];
+        }
+        slot->mutations += c.mutations;
+        slot->migration_bytes += c.migration_bytes;
     }
+    #endif
 
     return FLAG_CONT;
 }
@@ -319,30 +1391,92 @@ int receive_island(int src_proc, ga_solution_t *dest, int from, int up_to)
 void slave_main(int proc_id, int from, int up_to, int gens)
 {
     int island_size = up_to - from;
-    uint32_t *chromosome_chunk = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim * island_size);
+    uint32_t *chromosome_chunk = NULL;
     ga_solution_t *pop = (ga_solution_t *) malloc(sizeof(ga_solution_t) * island_size);
 
-    ga_init(pop, island_size, tsp.dim, sizeof(uint32_t), chromosome_chunk, generate_tsp_solution);
+    if (packed)
+    {
+        int bounds[2] = {0, island_size};
+        pack_population(pop, 1, bounds);
+    }
+    else
+    {
+        chromosome_chunk = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim * island_size);
+        ga_init(pop, island_size, tsp.dim, sizeof(uint32_t), chromosome_chunk, generate_tsp_solution);
+    }
+
+    tsp_fingerprint_t *prints = (tsp_fingerprint_t *) malloc(sizeof(tsp_fingerprint_t) * island_size * 2);
+
+    // The process evolves island proc_id - 1 with the parameters of its profile
+    profile_t *p = island_profile(proc_id - 1);
+    if (p)
+        adapt_init(&adapts[0], p->mutations, p->k, TSP_MUTATIONS, p->op);
 
     printf("Process %d in slave_main, island_size = %d, from %d up to %d\n", proc_id, island_size, from, up_to);
-    while (receive_island(0, pop, 0, island_size) != FLAG_TERM)
+    PROF_SET_TID(proc_id - 1);
+    while (receive_island(0, pop, 0, island_size, prints, prints + island_size) != FLAG_TERM)
     {
+        size_t repaired = verify_tsp_solutions(pop, island_size, prints, prints + island_size);
+        if (repaired)
+            fprintf(stderr, "Note: process %d repaired %lu received tours\n", proc_id, repaired);
         // printf("slave_main:%d: FLAG_CONT\n", proc_id);
         // Evolve
-        mpi_ga(pop, gens, island_size);
+        mpi_ga(pop, gens, island_size, p);
         // Send back to master
         send_island(0, pop, 0, island_size);
     }
     // printf("slave_main:%d: FLAG_TERM\n", proc_id);
 
+    if (packed)
+    {
+        tsp_pack_flush();
+        pack_release(pop, island_size);
+        pack_free(&pack);
+    }
+    free(prints);
     free(pop);
     free(chromosome_chunk);
 }
+
+struct verify_arg {
+    ga_solution_t *population;
+    tsp_fingerprint_t *sent, *received;
+    size_t repaired[];          // per island
+};
+
+static void verify_island(size_t i, int worker, void *_arg)
+{
+    struct verify_arg *arg = (struct verify_arg *) _arg;
+    int from = thread_bounds[i], up_to = thread_bounds[i + 1];
+    arg->repaired[i] = verify_tsp_solutions(arg->population + from, up_to - from, arg->sent + from, arg->received + from);
+}
+
+// Compares the received islands' fingerprints with their senders', repairing the tours that differ
+// in parallel
+void verify_islands(pool_t *pool, ga_solution_t *population, tsp_fingerprint_t *sent, tsp_fingerprint_t *received)
+{
+    struct verify_arg *arg = (struct verify_arg *) malloc(sizeof(struct verify_arg) + sizeof(size_t) * num_threads);
+    *arg = (struct verify_arg) { .population = population, .sent = sent, .received = received };
+    pool_run(pool, num_threads, verify_island, arg);
+    for (int i = 0; i < num_threads; i++)
+        if (arg->repaired[i])
+            fprintf(stderr, "Note: repaired %lu tours received from island %d\n", arg->repaired[i], i);
+    free(arg);
+}
 #endif //MPI
 
 int main(int argc, char **argv)
 {
     parse_args(argc, argv);
+    if (profile_file)
+        load_profiles();
+    if (packed && (backbone_interval > 0 || island_workers > 1 || numa_local))
+    {
+        fprintf(stderr, "Note: -b, -F and -N are ignored with -Z\n");
+        backbone_interval = 0;
+        island_workers = 1;
+        numa_local = 0;
+    }
 
     #ifdef _OPENMP
     printf("Using OpenMP!\n\n");
@@ -367,8 +1501,31 @@ int main(int argc, char **argv)
         printf("Error: Too few nodes, for N islands need N+1 nodes.\n");
         exit(EXIT_FAILURE);
     }
+    // Slaves hold islands of a fixed size
+    if (balance && proc_id == 0)
+        fprintf(stderr, "Note: -U ignored with MPI\n");
+    balance = 0;
     #endif
 
+    if (batch_manifest)
+    {
+        #ifdef MPI
+        if (proc_id == 0)
+            fprintf(stderr, "Error: batch mode (-B) is not available with MPI\n");
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+        #else
+        batch_params_t defaults = { .population = population_size, .gens = max_gens, .k = tournament_size, .mutations = mutations, .op = mutation_op };
+        if (batch_run(batch_manifest, defaults, num_threads > 1 ? num_threads : 1, stdout) < 0)
+        {
+            fprintf(stderr, "Could not read batch manifest '%s'\n", batch_manifest);
+            exit(EXIT_FAILURE);
+        }
+        tsp_2d_free(tsp);
+        return 0;
+        #endif
+    }
+
     if (!tsp.dim)
     {
         if (optind >= argc)
@@ -384,6 +1541,50 @@ int main(int argc, char **argv)
         tsp = tsp_2d_read(argv[optind]);
     }
 
+    if (hilbert)
+        city_ids = tsp_2d_hilbert(&tsp);
+
+    if (decomp_size > 0)
+    {
+        #ifdef MPI
+        if (proc_id == 0)
+            fprintf(stderr, "Error: decomposition (-x) is not available with MPI\n");
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+        #else
+        // The clusters are solved without generation statistics
+        if (csv)
+            fprintf(stderr, "Note: -o ignored with -x\n");
+        printf("Dim = %lu\n", tsp.dim);
+        if (num_threads < 1)
+            num_threads = 1;
+        decompose();
+        tsp_2d_free(tsp);
+        free(city_ids);
+        if (csv)
+            fclose(csv);
+        return 0;
+        #endif
+    }
+
+    #ifndef MPI
+    if (auto_tune && !profile_file)
+    {
+        tune_hw_t hw;
+        tune_probe(&hw);
+        tune_config_t conf = tune_calibrate(&tsp, &hw, population_size, tournament_size, mutations, mutation_op, TUNE_SECONDS, stdout);
+        num_threads = conf.islands;
+        if (population_given && conf.islands * conf.island_size > population_size)
+            fprintf(stderr, "Note: -T grows the population from -p %d to %d\n", population_size, conf.islands * conf.island_size);
+        population_size = conf.islands * conf.island_size;
+        island_cross_interval = conf.interval;
+        printf("Using -t %d -p %d -u %d\n\n", num_threads, population_size, island_cross_interval);
+    }
+    #endif
+
+    if (coords_init(&coords, &tsp, coord_mode) == COORDS_DOUBLE && coord_mode > COORDS_DOUBLE)
+        fprintf(stderr, "Note: -R %s would change distances, using doubles\n", coords_names[coord_mode]);
+
     uint32_t *chromosome_chunk = NULL;
     ga_solution_t *population = NULL;
     
@@ -392,11 +1593,35 @@ int main(int argc, char **argv)
     #endif
 
     printf("Dim = %lu\n", tsp.dim);
-    chromosome_chunk = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim * population_size);
-    population = (ga_solution_t *) malloc(sizeof(ga_solution_t) * population_size);
+    if (coords.candidate != COORDS_DOUBLE && gen_info_interval >= 0)
+        report_coords();
+    #ifdef MPI
+    numa_local = 0;
+    #endif
+    if (!numa_local)
+    {
+        if (!packed)
+            chromosome_chunk = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim * population_size);
+        population = (ga_solution_t *) malloc(sizeof(ga_solution_t) * population_size);
+    }
+
+    if (events_target && events_open(events_target, tsp.dim, city_ids) < 0)
+    {
+        fprintf(stderr, "Could not open events target '%s'\n", events_target);
+        exit(EXIT_FAILURE);
+    }
+
+    if (gap_target >= 0)
+        bound_start(&tsp);
 
     if (csv)
-        fprintf(csv, "Island,Generation,Best,Elite%%,Elite,Average,Worst\n");
+        fprintf(csv, "Island,Generation,Best,Elite%%,Elite,Average,Worst,Seconds,Distinct%%,EdgeEntropy,Clones,CacheHit%%,Mutation,Tournament,Operator,Success%%,LowerBound,Gap%%,Profile\n");
+
+    if (decisions_filename && !open_decisions(1))
+    {
+        fprintf(stderr, "Could not open decisions output '%s'\n", decisions_filename);
+        exit(EXIT_FAILURE);
+    }
 
     #ifdef MPI
     }
@@ -415,7 +1640,7 @@ int main(int argc, char **argv)
         thread_bounds[0] = low;
         for (int i = 0; i < num_threads - 1; i++)
         {
-            low += population_size / num_threads;
+            low += island_sizes ? island_sizes[i] : population_size / num_threads;
             thread_bounds[i + 1] = low;
         }
         thread_bounds[num_threads] = population_size;
@@ -427,16 +1652,53 @@ int main(int argc, char **argv)
         thread_bounds[1] = population_size;
     }
 
+    if (numa_local)
+        place_islands(&chromosome_chunk, &population);
+
+    if (prof_filename)
+    {
+        #ifdef PROF
+        #ifdef MPI
+        if (!prof_init(proc_id == 0 ? prof_filename : NULL, num_threads, island_workers > 1 ? num_threads * (island_workers - 1) : 0))
+        #else
+        if (!prof_init(prof_filename, num_threads, island_workers > 1 ? num_threads * (island_workers - 1) : 0))
+        #endif
+        {
+            fprintf(stderr, "Could not open profiling output '%s'\n", prof_filename);
+            exit(EXIT_FAILURE);
+        }
+        PROF_SET_TID(num_threads);
+        #else
+        fprintf(stderr, "Note: -P ignored, profiling needs a build with -DPROF\n");
+        #endif
+    }
+
+    init_extensions();
+    // Islands of -X ils profiles share one set of neighbor lists
+    for (int i = 0; i < profile_count && !ils.nearest; i++)
+        if (profiles[i].worker == PROFILE_ILS)
+            ils_init(&ils, &tsp);
+
     #ifndef MPI
     rbufs = (struct drand48_data *) malloc(sizeof(struct drand48_data) * num_threads);
     for (int i = 0; i < num_threads; i++)
         srand48_r(rand(), &rbufs[i]);
+    tsp_default = (tsp_context_t) { .instance = &tsp, .rbuf = &rbufs[0], .mutations = mutations };
+    tsp_default.coords = &coords;
+    init_pools(num_threads);
     #else
     rbufs = (struct drand48_data *) malloc(sizeof(struct drand48_data));
     srand48_r(rand() + proc_id, rbufs);
+    tsp_default = (tsp_context_t) { .instance = &tsp, .rbuf = rbufs, .mutations = mutations };
+    tsp_default.coords = &coords;
+    if (proc_id > 0)
+        init_pools(1);
 
     if (proc_id > 0)
     {
+        island_base = num_threads > 1 ? proc_id - 1 : 0;
+        if (decisions_filename && !open_decisions(0))
+            fprintf(stderr, "Note: process %d could not open '%s', its decisions are not recorded\n", proc_id, decisions_filename);
         int gens = max_gens;
         if (island_cross_interval > 0)
             gens = island_cross_interval;
@@ -446,17 +1708,42 @@ int main(int argc, char **argv)
         else
             slave_main(proc_id, 0, population_size, gens - 1);
         MPI_Finalize();
+        free_pools(1);
         free(rbufs);
+        free_caches();
+        free(exts);
+        free(adapts);
+        free(profiles);
+        free(island_sizes);
+        ils_free(&ils);
+        coords_free(&coords);
+        prof_free();
         tsp_2d_free(tsp);
+        if (decisions)
+            fclose(decisions);
 
         return 0;
     }
     #endif
 
     /* Initialize population */
-    ga_init(population, population_size, tsp.dim, sizeof(uint32_t), chromosome_chunk, generate_tsp_solution);
+    if (packed)
+        pack_population(population, num_threads, thread_bounds);
+    else
+        ga_init(population, population_size, tsp.dim, sizeof(uint32_t), chromosome_chunk, generate_tsp_solution);
+    if (warm_count)
+        warm_start(population);
+
+    #ifdef MPI
+    // Sent and received fingerprints of the islands, broken tours are repaired on the master's idle cores
+    tsp_fingerprint_t *migrant_prints = (tsp_fingerprint_t *) malloc(sizeof(tsp_fingerprint_t) * population_size * 2);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    pool_t *verify_pool = pool_create(cores < num_threads ? (cores > 0 ? cores : 1) : num_threads, 0);
+    #endif
 
     int gen = 0;
+    int epoch = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
 
     // DEBUG
     #ifdef DEBUG
@@ -475,12 +1762,22 @@ int main(int argc, char **argv)
         {
             if (gen_info_interval > 0)
             {
-                gen_info(population, 0);
+                gen_info(population, 0, &exts[num_threads], &adapts[num_threads]);
 
+                PROF_SET_TID(0);
                 gen = serial_ga(population, (max_gens - gen - gen_info_interval >= 0) ? gen_info_interval : max_gens - gen);
             }
             else 
+            {
+                PROF_SET_TID(0);
                 gen = serial_ga(population, max_gens);
+            }
+            PROF_SET_TID(num_threads);
+            prof_report(epoch++);
+            if (gap_reached(population, gen))
+                break;
+            fix_backbone(population, gen);
+            rebase_islands(population);
             continue;
         }
         #endif
@@ -493,9 +1790,10 @@ int main(int argc, char **argv)
             #pragma omp parallel for
             for (int i = 0; i < num_threads; i++)
             {
+                PROF_SET_TID(i);
                 if (gen_info_interval > 0)
-                    gen_info(population, i);
-                args[i] = (struct parallel_ga_arg) { .population = population, .gens = max_gens, .low = thread_bounds[i], .high = thread_bounds[i + 1] };
+                    gen_info(population, i, &exts[i], &adapts[i]);
+                args[i] = (struct parallel_ga_arg) { .population = population, .gens = max_gens, .low = thread_bounds[i], .high = thread_bounds[i + 1], .t = i };
                 parallel_ga(&args[i]);
             }
             #else
@@ -505,22 +1803,23 @@ int main(int argc, char **argv)
             for (int i = 0; i < num_threads; i++)
             {
                 // printf("Sending to %d, island_size = %d, from %d up to %d\n", i + 1, thread_bounds[i+1] - thread_bounds[i], thread_bounds[i], thread_bounds[i+1]);
-                gen_info(population, i);
+                gen_info(population, i, &exts[i], &adapts[i]);
                 send_island(i + 1, population, thread_bounds[i], thread_bounds[i + 1]);
             }
 
             // Receive islands, put back into population array
             for (int i = 0; i < num_threads; i++)
             {
-                receive_island(i + 1, population, thread_bounds[i], thread_bounds[i + 1]);
+                receive_island(i + 1, population, thread_bounds[i], thread_bounds[i + 1], migrant_prints, migrant_prints + population_size);
             }
+            verify_islands(verify_pool, population, migrant_prints, migrant_prints + population_size);
 
             #else
             for (int i = 0; i < num_threads; i++)
             {
                 if (gen_info_interval > 0)
-                    gen_info(population, i);
-                args[i] = (struct parallel_ga_arg) { .population = population, .gens = max_gens, .low = thread_bounds[i], .high = thread_bounds[i + 1] };
+                    gen_info(population, i, &exts[i], &adapts[i]);
+                args[i] = (struct parallel_ga_arg) { .population = population, .gens = max_gens, .low = thread_bounds[i], .high = thread_bounds[i + 1], .t = i };
                 pthread_create(&threads[i], NULL, parallel_ga, &args[i]);
             }
             #endif
@@ -534,8 +1833,9 @@ int main(int argc, char **argv)
             #pragma omp parallel for
             for (int i = 0; i < num_threads; i++)
             {
+                PROF_SET_TID(i);
                 if (gen_info_interval > 0)
-                    gen_info(population, i);
+                    gen_info(population, i, &exts[i], &adapts[i]);
                 args[i] = (struct parallel_ga_arg) { .population = population, .gens = ((max_gens - gen - island_cross_interval >= 0) ? island_cross_interval : max_gens - gen) - 1, .low = thread_bounds[i], .high = thread_bounds[i + 1], .t = i };
                 parallel_ga(&args[i]);
             }
@@ -546,21 +1846,22 @@ int main(int argc, char **argv)
             for (int i = 0; i < num_threads; i++)
             {
                 // printf("Sending to %d, island_size = %d, from %d up to %d\n", i + 1, thread_bounds[i+1] - thread_bounds[i], thread_bounds[i], thread_bounds[i+1]);
-                gen_info(population, i);
+                gen_info(population, i, &exts[i], &adapts[i]);
                 send_island(i + 1, population, thread_bounds[i], thread_bounds[i + 1]);
             }
 
             // Receive islands, put back into population array
             for (int i = 0; i < num_threads; i++)
             {
-                receive_island(i + 1, population, thread_bounds[i], thread_bounds[i + 1]);
+                receive_island(i + 1, population, thread_bounds[i], thread_bounds[i + 1], migrant_prints, migrant_prints + population_size);
             }
+            verify_islands(verify_pool, population, migrant_prints, migrant_prints + population_size);
 
             #else
             for (int i = 0; i < num_threads; i++)
             {
                 if (gen_info_interval > 0)
-                    gen_info(population, i);
+                    gen_info(population, i, &exts[i], &adapts[i]);
                 args[i] = (struct parallel_ga_arg) { .population = population, .gens = ((max_gens - gen - island_cross_interval >= 0) ? island_cross_interval : max_gens - gen) - 1, .low = thread_bounds[i], .high = thread_bounds[i + 1], .t = i };
                 pthread_create(&threads[i], NULL, parallel_ga, &args[i]);
             }
@@ -579,10 +1880,15 @@ int main(int argc, char **argv)
         }
         #endif
         #endif
+        PROF_SET_TID(num_threads);
+
+        if (profiles && island_cross_interval > 0)
+            score_profiles(population);
+        if (balance && island_cross_interval > 0)
+            balance_islands(args);
         free(args);
 
         #ifdef MPI
-        verify_tsp_solutions(population, population_size, rbufs);
         // TODO MPI code
         // printf("Master in main\n");
         for (int i = 0; i < population_size; i++)
@@ -595,28 +1901,58 @@ int main(int argc, char **argv)
         if (island_cross_interval > 0)
             gen = serial_ga(population, 1);
         #endif
+        prof_report(epoch++);
+        if (gap_reached(population, gen))
+            break;
+        #ifndef MPI
+        fix_backbone(population, gen);
+        #endif
+        rebase_islands(population);
     }
 
     /* Print last generation */
     if (gen_info_interval >= 0)
     {
         if (num_threads <= 1)
-            gen_info(population, 0);
+            gen_info(population, 0, &exts[num_threads], &adapts[num_threads]);
         else 
         {
             if (gen_info_interval > 0)
             {
                 for (int i = 0; i < num_threads; i++)
-                    gen_info(population, i);
+                    gen_info(population, i, &exts[i], &adapts[i]);
                 printf("\n");
             }
             
-            /* Print total stats */
+            /* Print total stats, with the clones and cache hits of the whole run */
+            ga_ext_t total = exts[0];
+            total.clones = ext_shown.clones;
+            total.lookups = ext_shown.lookups;
+            total.hits = ext_shown.hits;
+            for (int i = 0; i <= num_threads; i++)
+            {
+                total.clones += exts[i].clones;
+                total.lookups += exts[i].lookups;
+                total.hits += exts[i].hits;
+            }
             int aux = num_threads;
             num_threads = 0;
-            gen_info(population, 0);
+            gen_info(population, 0, &total, NULL);
             num_threads = aux;
         }
+        if (profiles && island_cross_interval > 0)
+            profile_report();
+    }
+
+    events_close();
+    bound_stop();
+    prof_report(epoch);
+    check_coords(population);
+    if (packed && gen_info_interval >= 0)
+    {
+        double mb = 1024.0 * 1024.0;
+        size_t bytes = pack_bytes(population, population_size), full = sizeof(uint32_t) * tsp.dim * population_size;
+        printf("Packed tours: %.2f MB, %.1f%% of %.2f MB unpacked\n", bytes / mb, 100.0 * bytes / full, full / mb);
     }
 
     /* Print best path */
@@ -624,19 +1960,45 @@ int main(int argc, char **argv)
     {
         ga_select_trunc(population, population_size, GA_MINIMIZE, percent_dead, percent_elite, fitness);
         printf("\nBest path after %d generations: %lu\n", max_gens, population[0].fitness);
+        uint32_t *best = tsp_tour(&population[0], 0);
+        if (backbone.nodes)
+        {
+            best = (uint32_t *) malloc(sizeof(uint32_t) * tsp.dim);
+            backbone_expand(&backbone, &tsp, (uint32_t *) population[0].chromosome, best);
+        }
         for (int i = 0; i < tsp.dim; i++)
         {
-            uint32_t n = ((uint32_t *)population[0].chromosome)[i];
-            printf("%s%u ", (i) ? "-> " : "", n);
+            uint32_t n = best[i];
+            printf("%s%u ", (i) ? "-> " : "", city_ids ? city_ids[n] : n);
         }
         printf("\n");
+        if (backbone.nodes)
+            free(best);
+        tsp_pack_flush();
     }
     
-    free(population);
-    free(chromosome_chunk);
+    if (packed)
+    {
+        tsp_pack_flush();
+        pack_release(population, population_size);
+        pack_free(&pack);
+    }
+    if (numa_local)
+    {
+        arena_unmap(&arenas[0]);
+        arena_unmap(&arenas[1]);
+        free(island_cpus);
+    }
+    else
+    {
+        free(population);
+        free(chromosome_chunk);
+    }
     tsp_2d_free(tsp);
     if (csv)
         fclose(csv);
+    if (decisions)
+        fclose(decisions);
     #ifndef _OPENMP
     #ifndef MPI
     if (threads)
@@ -644,7 +2006,21 @@ int main(int argc, char **argv)
     #endif
     #endif
     free(thread_bounds);
+    free(warm_files);
+    free(city_ids);
+    backbone_free(&backbone);
+    free(profiles);
+    free(island_sizes);
+    ils_free(&ils);
+    coords_free(&coords);
+    #ifndef MPI
+    free_pools(num_threads);
+    #endif
     free(rbufs);
+    free_caches();
+    free(exts);
+    free(adapts);
+    prof_free();
 
     #ifdef MPI
     for (int i = 0; i < num_threads; i++)
@@ -652,6 +2028,8 @@ int main(int argc, char **argv)
         // Send termination signal
         send_island(i + 1, NULL, 0, 0);
     }
+    pool_destroy(verify_pool);
+    free(migrant_prints);
     MPI_Finalize();
     #endif
     return 0;
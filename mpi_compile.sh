@@ -3,4 +3,4 @@
 # For debug mode add "-DDEBUG"
 # This will cause the master node to print its PID, which can be attached to via "$ gdb --pid <PID>"
 # TODO: Make it print the hostname as well
-mpicc -Wall -o ga-tsp-mpi main.c genetic.c tsp_parser.c tsp.c -lrt -lm -DMPI $1
+mpicc -Wall -o ga-tsp-mpi main.c genetic.c tsp_parser.c tsp.c tour.c diversity.c fcache.c pool.c decomp.c arena.c adapt.c batch.c events.c bound.c tune.c backbone.c profile.c options.c ils.c pack.c coords.c balance.c prof.c -lrt -lm -DMPI $1
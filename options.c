@@ -0,0 +1,39 @@
+#include "options.h"
+#include "tsp.h"
+#include <stdlib.h>
+#include <string.h>
+
+int options_parse(char **save, const char *allowed, options_t *opts)
+{
+    char *opt, *val;
+    while ((opt = strtok_r(NULL, OPTIONS_DELIM, save)))
+    {
+        if (opt[0] != '-' || !opt[1] || opt[2] || !strchr(allowed, opt[1]) || !(val = strtok_r(NULL, OPTIONS_DELIM, save)))
+            return 0;
+        switch (opt[1])
+        {
+            case 'g':
+                opts->gens = atoi(val);
+                break;
+            case 'k':
+                opts->k = atoi(val);
+                break;
+            case 'm':
+                opts->mutations = atoi(val);
+                break;
+            case 'M':
+                if ((opts->op = tsp_mutation_find(val)) < 0)
+                    return 0;
+                break;
+            case 'p':
+                opts->population = atoi(val);
+                break;
+            case 'X':
+                opts->worker = val;
+                break;
+            default:
+                return 0;
+        }
+    }
+    return 1;
+}
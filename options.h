@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+    Options of the lines of batch manifests and island profiles
+
+    After its leading fields a line holds pairs of an option and its value, e.g.
+
+        -k 2 -m 20000 -M segment
+
+    Each reader allows its own subset of -g (generations), -k (tournament size), -m (mutation
+    rate), -M (mutation operator by name), -p (population) and -X (worker by name).
+*/
+
+#define OPTIONS_DELIM " \t\r\n"     // separators of the fields of a line
+
+typedef struct {
+    int gens;
+    int population;
+    int k;
+    int mutations;
+    int op;                 // index in tsp_mutation_ops
+    const char *worker;     // value of -X, pointing into the line
+} options_t;
+
+// Parses the pairs left in the strtok_r state save into opts, which keeps the values of the
+// options not given. Returns 0 on an option not in allowed, a missing value or an unknown
+// mutation operator
+int options_parse(char **save, const char *allowed, options_t *opts);
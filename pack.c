@@ -0,0 +1,329 @@
+#include "pack.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NONE UINT32_MAX
+
+typedef struct {
+    ga_solution_t *owner;   // NULL if the slot is free
+    uint32_t *tour;
+    int dirty;
+    unsigned long used;     // tick of the last open, the oldest slot is reused first
+} slot_t;
+
+static __thread slot_t slots[PACK_SLOTS];
+static __thread uint32_t *peeked = NULL; // last tour unpacked by pack_peek
+static __thread uint32_t *marks = NULL; // per city, index of its triple while unpacking, else NONE
+static __thread size_t slots_dim = 0;
+static __thread unsigned long tick = 0;
+
+void pack_init(pack_t *p, size_t dim, int refs)
+{
+    p->dim = dim;
+    p->refs = refs;
+    p->tours = (uint32_t *) malloc(sizeof(uint32_t) * dim * refs);
+    p->adj = (uint32_t *) malloc(sizeof(uint32_t) * 2 * dim * refs);
+}
+
+void pack_free(pack_t *p)
+{
+    free(p->tours);
+    free(p->adj);
+    *p = (pack_t) {0};
+}
+
+static void adjacency(size_t n, const uint32_t *tour, uint32_t *adj)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        adj[2 * tour[i]] = tour[(i + n - 1) % n];
+        adj[2 * tour[i] + 1] = tour[(i + 1) % n];
+    }
+}
+
+void pack_reference(pack_t *p, int r, const uint32_t *tour)
+{
+    memcpy(p->tours + r * p->dim, tour, sizeof(uint32_t) * p->dim);
+    adjacency(p->dim, tour, p->adj + 2 * r * p->dim);
+}
+
+// Resizes the record of sol to hold words words, keeping it while it isn't more than twice that
+static uint32_t *resize(ga_solution_t *sol, size_t words)
+{
+    uint32_t *rec = (uint32_t *) sol->chromosome;
+    if (!rec || words > rec[1] || 2 * words < rec[1])
+    {
+        rec = (uint32_t *) realloc(rec, sizeof(uint32_t) * words);
+        rec[1] = words;
+        sol->chromosome = rec;
+    }
+    return rec;
+}
+
+static inline int same_neighbors(const uint32_t *adj, uint32_t c, uint32_t a, uint32_t b)
+{
+    uint32_t x = adj[2 * c], y = adj[2 * c + 1];
+    return (a == x && b == y) || (a == y && b == x);
+}
+
+static void encode(size_t n, const uint32_t *adj, ga_solution_t *sol, int r, const uint32_t *tour)
+{
+    size_t m = 0;
+    if (n >= 3)
+        for (size_t i = 0; i < n; i++)
+            m += !same_neighbors(adj, tour[i], tour[(i + n - 1) % n], tour[(i + 1) % n]);
+
+    if (n < 3 || 3 * m >= n)
+    {
+        uint32_t *rec = resize(sol, PACK_HEADER + n);
+        rec[0] = r;
+        rec[2] = PACK_WHOLE;
+        memcpy(rec + PACK_HEADER, tour, sizeof(uint32_t) * n);
+        return;
+    }
+
+    uint32_t *rec = resize(sol, PACK_HEADER + 3 * m);
+    rec[0] = r;
+    rec[2] = m;
+    rec[3] = tour[0];
+    rec[4] = tour[1];
+    uint32_t *t = rec + PACK_HEADER;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t c = tour[i], a = tour[(i + n - 1) % n], b = tour[(i + 1) % n];
+        if (!same_neighbors(adj, c, a, b))
+        {
+            *t++ = c;
+            *t++ = a;
+            *t++ = b;
+        }
+    }
+}
+
+// Walks the neighbors of the reference, replaced by those of the triples, from the first two
+// cities. mark must be NONE for every city and is left that way
+static void decode(size_t n, const uint32_t *adj, const uint32_t *rec, uint32_t *tour, uint32_t *mark)
+{
+    if (rec[2] == PACK_WHOLE)
+    {
+        memcpy(tour, rec + PACK_HEADER, sizeof(uint32_t) * n);
+        return;
+    }
+
+    const uint32_t *t = rec + PACK_HEADER;
+    uint32_t m = rec[2];
+    for (uint32_t j = 0; j < m; j++)
+        mark[t[3 * j]] = j;
+
+    uint32_t prev = rec[3], cur = rec[4];
+    tour[0] = prev;
+    tour[1] = cur;
+    for (size_t i = 2; i < n; i++)
+    {
+        const uint32_t *nb = mark[cur] != NONE ? t + 3 * mark[cur] + 1 : adj + 2 * cur;
+        uint32_t next = nb[0] != prev ? nb[0] : nb[1];
+        tour[i] = next;
+        prev = cur;
+        cur = next;
+    }
+
+    for (uint32_t j = 0; j < m; j++)
+        mark[t[3 * j]] = NONE;
+}
+
+static uint32_t *alloc_marks(size_t n)
+{
+    uint32_t *mark = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    for (size_t i = 0; i < n; i++)
+        mark[i] = NONE;
+    return mark;
+}
+
+void pack_store(const pack_t *p, ga_solution_t *sol, int r, const uint32_t *tour)
+{
+    encode(p->dim, p->adj + 2 * r * p->dim, sol, r, tour);
+}
+
+void pack_load(const pack_t *p, const ga_solution_t *sol, uint32_t *tour)
+{
+    const uint32_t *rec = (const uint32_t *) sol->chromosome;
+    uint32_t *mark = slots_dim == p->dim ? marks : alloc_marks(p->dim);
+    decode(p->dim, p->adj + 2 * rec[0] * p->dim, rec, tour, mark);
+    if (mark != marks)
+        free(mark);
+}
+
+int pack_ref(const ga_solution_t *sol)
+{
+    return ((const uint32_t *) sol->chromosome)[0];
+}
+
+void pack_rebase(pack_t *p, int r, ga_solution_t *pop, size_t size, const uint32_t *tour)
+{
+    size_t n = p->dim;
+    uint32_t *adj = (uint32_t *) malloc(sizeof(uint32_t) * 2 * n);
+    uint32_t *cities = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    uint32_t *mark = alloc_marks(n);
+    adjacency(n, tour, adj);
+    for (size_t i = 0; i < size; i++)
+    {
+        decode(n, p->adj + 2 * pack_ref(&pop[i]) * n, (uint32_t *) pop[i].chromosome, cities, mark);
+        encode(n, adj, &pop[i], r, cities);
+    }
+    memcpy(p->tours + r * n, tour, sizeof(uint32_t) * n);
+    memcpy(p->adj + 2 * r * n, adj, sizeof(uint32_t) * 2 * n);
+    free(mark);
+    free(cities);
+    free(adj);
+}
+
+void pack_rebase_all(pack_t *p, ga_solution_t *pop, const int *bounds, const uint32_t *tours)
+{
+    size_t n = p->dim;
+    // Records are unpacked with the references they were packed against, kept until all are done
+    uint32_t *old = p->adj;
+    p->adj = (uint32_t *) malloc(sizeof(uint32_t) * 2 * n * p->refs);
+    uint32_t *cities = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    uint32_t *mark = alloc_marks(n);
+    for (int r = 0; r < p->refs; r++)
+    {
+        memcpy(p->tours + r * n, tours + r * n, sizeof(uint32_t) * n);
+        adjacency(n, tours + r * n, p->adj + 2 * r * n);
+    }
+    for (int r = 0; r < p->refs; r++)
+        for (int i = bounds[r]; i < bounds[r + 1]; i++)
+        {
+            decode(n, old + 2 * pack_ref(&pop[i]) * n, (uint32_t *) pop[i].chromosome, cities, mark);
+            encode(n, p->adj + 2 * r * n, &pop[i], r, cities);
+        }
+    free(mark);
+    free(cities);
+    free(old);
+}
+
+void pack_release(ga_solution_t *pop, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        free(pop[i].chromosome);
+        pop[i].chromosome = NULL;
+    }
+}
+
+size_t pack_words(const ga_solution_t *sol)
+{
+    const uint32_t *rec = (const uint32_t *) sol->chromosome;
+    return PACK_HEADER + (rec[2] == PACK_WHOLE ? sol->chrom_len : 3 * rec[2]);
+}
+
+size_t pack_bytes(const ga_solution_t *pop, size_t size)
+{
+    size_t words = 0;
+    for (size_t i = 0; i < size; i++)
+        words += ((const uint32_t *) pop[i].chromosome)[1];
+    return sizeof(uint32_t) * words;
+}
+
+uint32_t *pack_record(ga_solution_t *sol, size_t words)
+{
+    // Exactly words, its capacity being overwritten by the sender's
+    sol->chromosome = realloc(sol->chromosome, sizeof(uint32_t) * (words < PACK_HEADER ? PACK_HEADER : words));
+    return (uint32_t *) sol->chromosome;
+}
+
+int pack_adopt(const pack_t *p, ga_solution_t *sol, int r, size_t words)
+{
+    size_t n = p->dim;
+    uint32_t *rec = (uint32_t *) sol->chromosome;
+    rec[1] = words < PACK_HEADER ? PACK_HEADER : words;
+    int valid = words >= PACK_HEADER;
+    if (valid && rec[2] == PACK_WHOLE)
+        valid = words == PACK_HEADER + n;
+    else if (valid)
+    {
+        valid = rec[2] < n && words == PACK_HEADER + 3 * (size_t) rec[2] && rec[3] < n && rec[4] < n;
+        for (size_t i = PACK_HEADER; valid && i < words; i++)
+            valid = rec[i] < n;
+    }
+    // The whole tour is checked by the caller, the triples only need to stay in range
+    if (valid)
+        rec[0] = r;
+    else
+        pack_store(p, sol, r, p->tours + r * n);
+    return valid;
+}
+
+// Packs the slot's tour back if it was written and frees it
+static void release(const pack_t *p, slot_t *s)
+{
+    if (s->owner && s->dirty)
+    {
+        int r = pack_ref(s->owner);
+        encode(p->dim, p->adj + 2 * r * p->dim, s->owner, r, s->tour);
+    }
+    s->owner = NULL;
+}
+
+// Allocates the calling thread's slots on its first use of p
+static void setup(const pack_t *p)
+{
+    if (slots_dim == p->dim)
+        return;
+    pack_flush(p);
+    for (int i = 0; i < PACK_SLOTS; i++)
+        slots[i].tour = (uint32_t *) malloc(sizeof(uint32_t) * p->dim);
+    peeked = (uint32_t *) malloc(sizeof(uint32_t) * p->dim);
+    marks = alloc_marks(p->dim);
+    slots_dim = p->dim;
+}
+
+uint32_t *pack_open(const pack_t *p, ga_solution_t *sol, int write)
+{
+    setup(p);
+    tick++;
+    for (int i = 0; i < PACK_SLOTS; i++)
+        if (slots[i].owner == sol)
+        {
+            slots[i].dirty |= write;
+            slots[i].used = tick;
+            return slots[i].tour;
+        }
+
+    // A free slot, or the one opened longest ago
+    slot_t *s = &slots[0];
+    for (int i = 1; i < PACK_SLOTS && s->owner; i++)
+        if (!slots[i].owner || slots[i].used < s->used)
+            s = &slots[i];
+
+    release(p, s);
+    pack_load(p, sol, s->tour);
+    s->owner = sol;
+    s->dirty = write;
+    s->used = tick;
+    return s->tour;
+}
+
+const uint32_t *pack_peek(const pack_t *p, const ga_solution_t *sol)
+{
+    setup(p);
+    for (int i = 0; i < PACK_SLOTS; i++)
+        if (slots[i].owner == sol)
+            return slots[i].tour;
+    pack_load(p, sol, peeked);
+    return peeked;
+}
+
+void pack_flush(const pack_t *p)
+{
+    if (!slots_dim)
+        return;
+    for (int i = 0; i < PACK_SLOTS; i++)
+    {
+        release(p, &slots[i]);
+        free(slots[i].tour);
+    }
+    free(peeked);
+    free(marks);
+    peeked = marks = NULL;
+    slots_dim = 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "genetic.h"
+
+/*
+    Packed tours: a population stored as edge differences to reference tours
+
+    Each island has a reference tour, its best one when it was last rebased. A packed solution's
+    chromosome points to a record listing the cities whose two neighbors differ from those in the
+    reference, with their neighbors in the solution, plus the solution's first two cities so that
+    unpacking gives back the same sequence. Tours sharing most edges with the reference take a
+    few words instead of one per city; those that share too few are stored whole.
+
+    Operators reach the tours through pack_open, which unpacks them into one of PACK_SLOTS slots
+    of the calling thread and packs them back when the slot is reused or at pack_flush. Slots
+    refer to their solutions by address, so they must be flushed before solutions are moved, as
+    by sorting. Records are only written by the thread that opened them, so islands may run in
+    parallel.
+
+    Record layout in 32-bit words: reference, capacity, m, first city, second city, then m
+    triples (city, neighbor, neighbor), or the whole tour if m is PACK_WHOLE.
+*/
+
+#define PACK_SLOTS  4
+#define PACK_WHOLE  UINT32_MAX
+#define PACK_HEADER 5
+#define PACK_REBASE 20      // generations between rebasing an island on its best tour
+
+typedef struct {
+    size_t dim;
+    int refs;
+    uint32_t *tours;        // refs reference tours
+    uint32_t *adj;          // per reference, both neighbors of every city
+} pack_t;
+
+void pack_init(pack_t *p, size_t dim, int refs);
+
+void pack_free(pack_t *p);
+
+// Makes tour reference r. Records packed against the previous one must be rebased instead
+void pack_reference(pack_t *p, int r, const uint32_t *tour);
+
+// Packs tour as the chromosome of sol against reference r, reusing its record if it has one
+void pack_store(const pack_t *p, ga_solution_t *sol, int r, const uint32_t *tour);
+
+// Unpacks the chromosome of sol into tour
+void pack_load(const pack_t *p, const ga_solution_t *sol, uint32_t *tour);
+
+// Reference the record of sol is packed against
+int pack_ref(const ga_solution_t *sol);
+
+// Makes tour reference r and packs the size solutions of pop against it. Their records may be
+// packed against any reference but those another thread is rebasing meanwhile
+void pack_rebase(pack_t *p, int r, ga_solution_t *pop, size_t size, const uint32_t *tour);
+
+// Makes tours + i * dim reference i for every reference and packs the solutions of pop in
+// [bounds[i], bounds[i + 1]) against it, whatever reference their records are packed against
+void pack_rebase_all(pack_t *p, ga_solution_t *pop, const int *bounds, const uint32_t *tours);
+
+// Frees the records of the size solutions of pop
+void pack_release(ga_solution_t *pop, size_t size);
+
+// Words in use by the record of sol
+size_t pack_words(const ga_solution_t *sol);
+
+// Bytes allocated to the records of the size solutions of pop
+size_t pack_bytes(const ga_solution_t *pop, size_t size);
+
+// Makes room for a record of words words arriving from elsewhere as the chromosome of sol and
+// returns it. Once written, pack_adopt makes it a record against reference r
+uint32_t *pack_record(ga_solution_t *sol, size_t words);
+
+// Validates a record written to pack_record, replacing it with the reference if it is malformed.
+// Returns 0 in that case
+int pack_adopt(const pack_t *p, ga_solution_t *sol, int r, size_t words);
+
+// Tour of sol, unpacked into a slot of the calling thread. If write is set it is packed again
+// when the slot is released
+uint32_t *pack_open(const pack_t *p, ga_solution_t *sol, int write);
+
+// Tour of sol to read until the next call, without taking a slot
+const uint32_t *pack_peek(const pack_t *p, const ga_solution_t *sol);
+
+// Releases every slot of the calling thread
+void pack_flush(const pack_t *p);
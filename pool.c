@@ -0,0 +1,183 @@
+#include "pool.h"
+#include "prof.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Range of indices [lo, hi) owned by a worker, packed as lo << 32 | hi so owner and thieves
+   can update it with a single compare and swap */
+typedef struct {
+    uint64_t range;
+} __attribute__((aligned(64))) pool_range_t;
+
+struct pool {
+    int workers;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t start, done;
+    unsigned long job;      // incremented for every pool_run
+    int running;            // helper threads still working on the current job
+    int quit;
+    int prof_slot;
+
+    size_t n;
+    void (*fn)(size_t, int, void *);
+    void *arg;
+    pool_range_t *ranges;
+};
+
+struct pool_thread_arg {
+    pool_t *pool;
+    int worker;
+};
+
+#define PACK(lo, hi) (((uint64_t) (lo) << 32) | (uint32_t) (hi))
+#define LO(r) ((uint32_t) ((r) >> 32))
+#define HI(r) ((uint32_t) (r))
+
+// Takes the next index of worker w's range, returns 0 if it is empty
+static int take(pool_t *pool, int w, size_t *i)
+{
+    uint64_t r = __atomic_load_n(&pool->ranges[w].range, __ATOMIC_ACQUIRE);
+    while (LO(r) < HI(r))
+    {
+        if (__atomic_compare_exchange_n(&pool->ranges[w].range, &r, PACK(LO(r) + 1, HI(r)), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            *i = LO(r);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Moves the back half of some other worker's range to worker w, returns 0 if all are empty
+static int steal(pool_t *pool, int w)
+{
+    for (int k = 1; k < pool->workers; k++)
+    {
+        int v = (w + k) % pool->workers;
+        uint64_t r = __atomic_load_n(&pool->ranges[v].range, __ATOMIC_ACQUIRE);
+        while (LO(r) < HI(r))
+        {
+            uint32_t mid = LO(r) + (HI(r) - LO(r)) / 2;
+            if (__atomic_compare_exchange_n(&pool->ranges[v].range, &r, PACK(LO(r), mid), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                __atomic_store_n(&pool->ranges[w].range, PACK(mid, HI(r)), __ATOMIC_RELEASE);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void run_job(pool_t *pool, int w)
+{
+    size_t i;
+    do
+    {
+        while (take(pool, w, &i))
+            pool->fn(i, w, pool->arg);
+    } while (steal(pool, w));
+}
+
+static void *pool_thread(void *_arg)
+{
+    struct pool_thread_arg arg = *(struct pool_thread_arg *) _arg;
+    free(_arg);
+    pool_t *pool = arg.pool;
+    unsigned long seen = 0;
+    PROF_SET_TID(pool->prof_slot + arg.worker - 1);
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (pool->job == seen && !pool->quit)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit)
+            break;
+        seen = pool->job;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_job(pool, arg.worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+pool_t *pool_create(int workers, int prof_slot)
+{
+    if (workers < 1)
+        workers = 1;
+
+    pool_t *pool = (pool_t *) calloc(1, sizeof(pool_t));
+    pool->workers = workers;
+    pool->prof_slot = prof_slot;
+    pool->ranges = (pool_range_t *) aligned_alloc(64, sizeof(pool_range_t) * workers);
+    pool->threads = (pthread_t *) malloc(sizeof(pthread_t) * workers);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int w = 1; w < workers; w++)
+    {
+        struct pool_thread_arg *arg = (struct pool_thread_arg *) malloc(sizeof(struct pool_thread_arg));
+        *arg = (struct pool_thread_arg) { .pool = pool, .worker = w };
+        pthread_create(&pool->threads[w], NULL, pool_thread, arg);
+    }
+    return pool;
+}
+
+int pool_size(pool_t *pool)
+{
+    return pool->workers;
+}
+
+void pool_run(pool_t *pool, size_t n, void (*fn)(size_t i, int worker, void *arg), void *arg)
+{
+    if (pool->workers == 1)
+    {
+        for (size_t i = 0; i < n; i++)
+            fn(i, 0, arg);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->n = n;
+    pool->fn = fn;
+    pool->arg = arg;
+    for (int w = 0; w < pool->workers; w++)
+        pool->ranges[w].range = PACK(n * w / pool->workers, n * (w + 1) / pool->workers);
+    pool->running = pool->workers - 1;
+    pool->job++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_job(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int w = 1; w < pool->workers; w++)
+        pthread_join(pool->threads[w], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool->ranges);
+    free(pool);
+}
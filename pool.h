@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+    Persistent worker pool running parallel loops with work stealing
+
+    Each call splits the index range evenly among the workers. A worker takes indices from the
+    front of its own range and, once empty, steals the back half of another worker's range.
+    The calling thread participates as worker 0.
+*/
+
+typedef struct pool pool_t;
+
+// Creates a pool with workers - 1 helper threads. Helper thread w uses profiling slot
+// prof_slot + w - 1
+pool_t *pool_create(int workers, int prof_slot);
+
+int pool_size(pool_t *pool);
+
+// Runs fn(i, worker, arg) for every i in [0, n) and returns once all calls have finished
+void pool_run(pool_t *pool, size_t n, void (*fn)(size_t i, int worker, void *arg), void *arg);
+
+void pool_destroy(pool_t *pool);
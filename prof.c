@@ -0,0 +1,131 @@
+#include "prof.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_TSC
+#endif
+
+prof_counters_t *prof_slots = NULL;
+__thread int prof_tid = 0;
+
+static FILE *prof_file = NULL;
+static int prof_nslots = 0;
+static int prof_islands = 0;
+static double prof_ticks_per_sec = 1e9;
+static struct timespec prof_last;
+
+static const char *prof_phase_names[PROF_PHASES] = {
+    "Fitness", "Crossover", "Mutate", "Select", "GenInfo", "Transfer"
+};
+
+static double elapsed(struct timespec a, struct timespec b)
+{
+    return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
+}
+
+uint64_t prof_now()
+{
+    #ifdef PROF_TSC
+    return __rdtsc();
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    #endif
+}
+
+double prof_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Estimates TSC frequency against the monotonic clock
+static void calibrate()
+{
+    #ifdef PROF_TSC
+    struct timespec a, b, d = { .tv_sec = 0, .tv_nsec = 20000000 };
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    uint64_t t0 = __rdtsc();
+    nanosleep(&d, NULL);
+    uint64_t t1 = __rdtsc();
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    prof_ticks_per_sec = (t1 - t0) / elapsed(a, b);
+    #endif
+}
+
+int prof_init(const char *filename, int islands, int workers)
+{
+    prof_islands = islands;
+    prof_nslots = islands + 1 + workers;
+    prof_slots = (prof_counters_t *) aligned_alloc(64, sizeof(prof_counters_t) * prof_nslots);
+    memset(prof_slots, 0, sizeof(prof_counters_t) * prof_nslots);
+    calibrate();
+
+    // MPI slaves only collect counters and ship them to the master
+    if (!filename)
+        return 1;
+
+    prof_file = fopen(filename, "wt");
+    if (!prof_file)
+    {
+        prof_free();
+        return 0;
+    }
+
+    fprintf(prof_file, "Epoch,Island,Seconds,Evaluations,Evals/s,Crossovers,Crossovers/s,Mutations,Tournaments,MigrationBytes");
+    for (int p = 0; p < PROF_PHASES; p++)
+        fprintf(prof_file, ",%sSec", prof_phase_names[p]);
+    fprintf(prof_file, "\n");
+
+    clock_gettime(CLOCK_MONOTONIC, &prof_last);
+    return 1;
+}
+
+void prof_report(int epoch)
+{
+    if (!prof_slots || !prof_file)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double secs = elapsed(prof_last, now);
+    prof_last = now;
+    if (secs <= 0)
+        secs = 1e-9;
+
+    for (int i = 0; i < prof_nslots; i++)
+    {
+        prof_counters_t *c = &prof_slots[i];
+        // After the islands come the main thread (migration generations, statistics) and
+        // the helper threads of batch engines
+        if (i == prof_islands)
+            fprintf(prof_file, "%d,main,", epoch);
+        else if (i > prof_islands)
+            fprintf(prof_file, "%d,worker%d,", epoch, i - prof_islands);
+        else
+            fprintf(prof_file, "%d,%d,", epoch, i);
+        fprintf(prof_file, "%.6f,%lu,%.1f,%lu,%.1f,%lu,%lu,%lu", secs,
+                c->calls[PROF_FITNESS], c->calls[PROF_FITNESS] / secs,
+                c->calls[PROF_CROSSOVER], c->calls[PROF_CROSSOVER] / secs,
+                c->mutations, c->calls[PROF_SELECT], c->migration_bytes);
+        for (int p = 0; p < PROF_PHASES; p++)
+            fprintf(prof_file, ",%.6f", c->ticks[p] / prof_ticks_per_sec);
+        fprintf(prof_file, "\n");
+    }
+    fflush(prof_file);
+    memset(prof_slots, 0, sizeof(prof_counters_t) * prof_nslots);
+}
+
+void prof_free()
+{
+    if (prof_file)
+        fclose(prof_file);
+    free(prof_slots);
+    prof_file = NULL;
+    prof_slots = NULL;
+}
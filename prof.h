@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+    Low overhead profiling of the GA hot path.
+
+    Counters live in one cache line padded slot per island so threads never share a line.
+    Timers read the TSC where available. Everything is compiled out unless built with -DPROF,
+    and when compiled in but not enabled with -P the cost is one predictable branch per probe.
+*/
+
+enum prof_phase {
+    PROF_FITNESS,
+    PROF_CROSSOVER,
+    PROF_MUTATE,
+    PROF_SELECT,
+    PROF_GEN_INFO,
+    PROF_TRANSFER,
+    PROF_PHASES
+};
+
+typedef struct {
+    uint64_t ticks[PROF_PHASES];
+    uint64_t calls[PROF_PHASES];
+    uint64_t mutations;         // gene swaps actually applied
+    uint64_t migration_bytes;   // chromosome bytes sent and received
+} __attribute__((aligned(64))) prof_counters_t;
+
+extern prof_counters_t *prof_slots;
+extern __thread int prof_tid;
+
+// Allocates one slot per island, one for the main thread and one per extra worker thread, then
+// writes the CSV header. With a NULL filename counters are collected but never written.
+// Returns 0 if the file could not be opened
+int prof_init(const char *filename, int islands, int workers);
+
+// Writes one row per slot with the counters accumulated since the last report, then resets them
+void prof_report(int epoch);
+
+void prof_free();
+
+uint64_t prof_now();
+
+// Seconds on the monotonic clock, for the timings that are always compiled in
+double prof_seconds();
+
+#ifdef PROF
+
+#define PROF_START(t)           uint64_t t = prof_slots ? prof_now() : 0
+#define PROF_STOP(t, phase)     do { if (prof_slots) { \
+                                    prof_slots[prof_tid].ticks[phase] += prof_now() - (t); \
+                                    prof_slots[prof_tid].calls[phase]++; } } while (0)
+#define PROF_COUNT(field, n)    do { if (prof_slots) prof_slots[prof_tid].field += (n); } while (0)
+#define PROF_SET_TID(i)         (prof_tid = (i))
+
+#else
+
+#define PROF_START(t)
+#define PROF_STOP(t, phase)
+#define PROF_COUNT(field, n)
+#define PROF_SET_TID(i)
+
+#endif
@@ -0,0 +1,57 @@
+#include "profile.h"
+#include "options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parses the options after the name, returns 0 on an unknown option, a missing or invalid value
+static int parse_options(char **save, profile_t *p)
+{
+    options_t o = { .population = p->size, .k = p->k, .mutations = p->mutations, .op = p->op };
+    if (!options_parse(save, "kmMpX", &o) || (o.population != p->size && o.population < 2))
+        return 0;
+    if (o.worker && strcmp(o.worker, "ga") == 0)
+        p->worker = PROFILE_GA;
+    else if (o.worker && strcmp(o.worker, "ils") == 0)
+        p->worker = PROFILE_ILS;
+    else if (o.worker)
+        return 0;
+    p->k = o.k;
+    p->mutations = o.mutations;
+    p->op = o.op;
+    p->size = o.population;
+    return 1;
+}
+
+int profile_load(const char *file, profile_t defaults, profile_t **profiles)
+{
+    FILE *fd = fopen(file, "rt");
+    if (!fd)
+        return -1;
+
+    int n = 0, line = 0;
+    char buf[BUFSIZ];
+    *profiles = NULL;
+    while (fgets(buf, sizeof(buf), fd))
+    {
+        line++;
+        char *save, *name = strtok_r(buf, OPTIONS_DELIM, &save);
+        if (!name || name[0] == '#')
+            continue;
+
+        profile_t p = defaults;
+        snprintf(p.name, sizeof(p.name), "%s", name);
+        if (!parse_options(&save, &p))
+        {
+            fprintf(stderr, "%s:%d: expected '<name> [-k|-m|-M|-p|-X value]...'\n", file, line);
+            fclose(fd);
+            free(*profiles);
+            *profiles = NULL;
+            return -1;
+        }
+        *profiles = (profile_t *) realloc(*profiles, sizeof(profile_t) * (n + 1));
+        (*profiles)[n++] = p;
+    }
+    fclose(fd);
+    return n;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+/*
+    Island profiles: per-island parameters read from a file
+
+    Each line names a profile and sets some of the -k, -m, -M, -p and -X options, e.g.
+
+        explore -k 2 -m 20000 -M segment
+        exploit -k 8 -m 500 -p 1500
+        polish -X ils
+
+    -X picks the island's worker: 'ga' evolves it, 'ils' runs iterated local search (ils.h) on
+    its best tour instead, the island taking part in the crossings like any other.
+
+    Blank lines and lines starting with '#' are skipped. Islands take the profiles in order,
+    starting over from the first when there are more islands than profiles. Options a profile
+    doesn't set take the command line's values, -p being the island's own population.
+*/
+
+#define PROFILE_NAME 32
+
+#define PROFILE_GA  0
+#define PROFILE_ILS 1
+
+typedef struct {
+    char name[PROFILE_NAME];
+    int k;
+    int mutations;
+    int op;                 // index in tsp_mutation_ops
+    int size;               // island population, 0 for an even share of -p
+    int worker;             // PROFILE_GA or PROFILE_ILS
+
+    /* Statistics, at the island crossings */
+    unsigned long islands;  // islands using the profile
+    unsigned long wins;     // crossings where one of its islands held the best tour
+    unsigned long elites;   // solutions among the best -e percent of the whole population
+    unsigned long crossings;    // crossings with any island using it, of which wins were won
+} profile_t;
+
+// Reads the profiles of file, unset options taking the values of defaults. Returns the number
+// of profiles, or -1 if the file can't be read or a line is malformed
+int profile_load(const char *file, profile_t defaults, profile_t **profiles);
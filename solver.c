@@ -0,0 +1,245 @@
+#include "solver.h"
+#include "genetic.h"
+#include "tsp.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct tsp_solver {
+    tsp_solver_params_t params;
+    tsp_2d_t tsp;
+    ga_solution_t *population;
+    uint32_t *chromosome_chunk;
+    int *bounds;                    // island i holds population[bounds[i] .. bounds[i + 1])
+    struct drand48_data *rbufs;     // one per island, the last one for crossing islands
+    tsp_context_t *contexts;        // same layout as rbufs
+    pool_t *pool;
+    int generation;
+    int island_gens;                // generations of the current pool_run
+};
+
+static void evolve_island(size_t i, int worker, void *arg)
+{
+    tsp_solver_t *s = (tsp_solver_t *) arg;
+    ga_solution_t *pop = s->population + s->bounds[i];
+    size_t size = s->bounds[i + 1] - s->bounds[i];
+
+    tsp_set_local(&s->contexts[i]);
+    for (int gen = 0; gen < s->island_gens; gen++)
+        tsp_engines[s->params.op](pop, size, s->params.k, s->params.mutations, &s->rbufs[i], NULL);
+    tsp_set_local(NULL);
+}
+
+tsp_solver_t *tsp_solver_create(const tsp_2d_t *instance, const tsp_solver_params_t *params)
+{
+    tsp_solver_params_t p = *params;
+    if (p.islands < 1)
+        p.islands = 1;
+    if (instance->dim < 2 || p.population / p.islands < 2 || p.op < 0 || p.op >= TSP_MUTATIONS)
+        return NULL;
+
+    tsp_solver_t *s = (tsp_solver_t *) calloc(1, sizeof(tsp_solver_t));
+    s->params = p;
+    s->tsp.dim = instance->dim;
+    s->tsp.nodes = (tsp_2d_node_t *) malloc(sizeof(tsp_2d_node_t) * instance->dim);
+    memcpy(s->tsp.nodes, instance->nodes, sizeof(tsp_2d_node_t) * instance->dim);
+
+    s->bounds = (int *) malloc(sizeof(int) * (p.islands + 1));
+    for (int i = 0; i <= p.islands; i++)
+        s->bounds[i] = (long) p.population * i / p.islands;
+
+    struct drand48_data seeder;
+    srand48_r(p.seed, &seeder);
+    s->rbufs = (struct drand48_data *) malloc(sizeof(struct drand48_data) * (p.islands + 1));
+    s->contexts = (tsp_context_t *) malloc(sizeof(tsp_context_t) * (p.islands + 1));
+    for (int i = 0; i <= p.islands; i++)
+    {
+        long seed;
+        lrand48_r(&seeder, &seed);
+        srand48_r(seed, &s->rbufs[i]);
+        s->contexts[i] = (tsp_context_t) { .instance = &s->tsp, .rbuf = &s->rbufs[i], .mutations = p.mutations };
+    }
+
+    s->chromosome_chunk = (uint32_t *) malloc(sizeof(uint32_t) * s->tsp.dim * p.population);
+    s->population = (ga_solution_t *) malloc(sizeof(ga_solution_t) * p.population);
+    for (int i = 0; i < p.islands; i++)
+    {
+        tsp_set_local(&s->contexts[i]);
+        ga_init(s->population + s->bounds[i], s->bounds[i + 1] - s->bounds[i], s->tsp.dim, sizeof(uint32_t),
+                s->chromosome_chunk + (size_t) s->bounds[i] * s->tsp.dim, generate_tsp_solution);
+    }
+    tsp_set_local(NULL);
+
+    s->pool = pool_create(p.islands, 0);
+    return s;
+}
+
+int tsp_solver_step(tsp_solver_t *solver)
+{
+    return tsp_solver_run(solver, 1);
+}
+
+int tsp_solver_run(tsp_solver_t *s, int gens)
+{
+    int islands = s->params.islands;
+    int migration = islands > 1 ? s->params.migration : 0;
+
+    while (gens > 0)
+    {
+        // Every migration-th generation crosses the islands by evolving the whole population
+        if (migration > 0 && (s->generation + 1) % migration == 0)
+        {
+            tsp_set_local(&s->contexts[islands]);
+            tsp_engines[s->params.op](s->population, s->params.population, s->params.k, s->params.mutations, &s->rbufs[islands], NULL);
+            tsp_set_local(NULL);
+            s->generation++;
+            gens--;
+            continue;
+        }
+
+        int n = gens;
+        if (migration > 0 && n > migration - 1 - s->generation % migration)
+            n = migration - 1 - s->generation % migration;
+        s->island_gens = n;
+        pool_run(s->pool, islands, evolve_island, s);
+        s->generation += n;
+        gens -= n;
+    }
+    return s->generation;
+}
+
+// Removes city from the first len cities of tour
+static void tour_remove(uint32_t *tour, size_t len, uint32_t city)
+{
+    size_t i = 0;
+    while (tour[i] != city)
+        i++;
+    memmove(tour + i, tour + i + 1, sizeof(uint32_t) * (len - i - 1));
+}
+
+// Inserts city into the first len cities of tour at the edge where it adds the least length
+static void tour_insert_cheapest(uint32_t *tour, size_t len, uint32_t city, const tsp_2d_node_t *nodes)
+{
+    size_t best = len;
+    double best_cost = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint32_t a = tour[i], b = tour[(i + 1) % len];
+        double cost = dist(nodes[a], nodes[city]) + dist(nodes[city], nodes[b]) - dist(nodes[a], nodes[b]);
+        if (best == len || cost < best_cost)
+        {
+            best = i + 1;
+            best_cost = cost;
+        }
+    }
+    memmove(tour + best + 1, tour + best, sizeof(uint32_t) * (len - best));
+    tour[best] = city;
+}
+
+int tsp_solver_update(tsp_solver_t *s, const tsp_delta_t *deltas, int n)
+{
+    // Check the whole batch first
+    size_t dim = s->tsp.dim, inserts = 0;
+    for (int d = 0; d < n; d++)
+    {
+        if (deltas[d].type == TSP_DELTA_INSERT)
+            inserts++, dim++;
+        else if (deltas[d].city >= dim || (deltas[d].type == TSP_DELTA_DELETE && --dim < 2))
+            return -1;
+    }
+
+    // Tours are repaired in a chunk with room for every insertion, then packed
+    size_t cap = s->tsp.dim + inserts, pop = s->params.population;
+    uint32_t *work = (uint32_t *) malloc(sizeof(uint32_t) * cap * pop);
+    for (size_t i = 0; i < pop; i++)
+        memcpy(work + i * cap, s->population[i].chromosome, sizeof(uint32_t) * s->tsp.dim);
+    s->tsp.nodes = (tsp_2d_node_t *) realloc(s->tsp.nodes, sizeof(tsp_2d_node_t) * cap);
+
+    dim = s->tsp.dim;
+    for (int d = 0; d < n; d++)
+    {
+        const tsp_delta_t *delta = &deltas[d];
+        uint32_t city = delta->city;
+        switch (delta->type)
+        {
+            case TSP_DELTA_INSERT:
+                city = dim++;
+                s->tsp.nodes[city] = (tsp_2d_node_t) { .x = delta->x, .y = delta->y };
+                for (size_t i = 0; i < pop; i++)
+                    tour_insert_cheapest(work + i * cap, dim - 1, city, s->tsp.nodes);
+                break;
+            case TSP_DELTA_MOVE:
+                s->tsp.nodes[city] = (tsp_2d_node_t) { .x = delta->x, .y = delta->y };
+                for (size_t i = 0; i < pop; i++)
+                {
+                    tour_remove(work + i * cap, dim, city);
+                    tour_insert_cheapest(work + i * cap, dim - 1, city, s->tsp.nodes);
+                }
+                break;
+            case TSP_DELTA_DELETE:
+                dim--;
+                s->tsp.nodes[city] = s->tsp.nodes[dim];
+                for (size_t i = 0; i < pop; i++)
+                {
+                    uint32_t *tour = work + i * cap;
+                    tour_remove(tour, dim + 1, city);
+                    for (size_t j = 0; j < dim && city != dim; j++)
+                        if (tour[j] == dim)
+                        {
+                            tour[j] = city;
+                            break;
+                        }
+                }
+                break;
+        }
+    }
+
+    s->tsp.dim = dim;
+    free(s->chromosome_chunk);
+    s->chromosome_chunk = (uint32_t *) malloc(sizeof(uint32_t) * dim * pop);
+    for (size_t i = 0; i < pop; i++)
+    {
+        ga_solution_t *sol = &s->population[i];
+        sol->chromosome = s->chromosome_chunk + i * dim;
+        memcpy(sol->chromosome, work + i * cap, sizeof(uint32_t) * dim);
+        sol->chrom_len = dim;
+        sol->fit_gen = 0;
+        sol->hash = 0;
+    }
+    free(work);
+    return 0;
+}
+
+size_t tsp_solver_dim(const tsp_solver_t *s)
+{
+    return s->tsp.dim;
+}
+
+int64_t tsp_solver_best(tsp_solver_t *s, uint32_t *tour)
+{
+    tsp_set_local(&s->contexts[s->params.islands]);
+    int best = 0;
+    for (int i = 1; i < s->params.population; i++)
+        if (fitness(&s->population[i]) < fitness(&s->population[best]))
+            best = i;
+    int64_t length = fitness(&s->population[best]);
+    tsp_set_local(NULL);
+
+    if (tour)
+        memcpy(tour, s->population[best].chromosome, sizeof(uint32_t) * s->tsp.dim);
+    return length;
+}
+
+void tsp_solver_destroy(tsp_solver_t *s)
+{
+    if (!s)
+        return;
+    pool_destroy(s->pool);
+    free(s->population);
+    free(s->chromosome_chunk);
+    free(s->contexts);
+    free(s->rbufs);
+    free(s->bounds);
+    tsp_2d_free(s->tsp);
+    free(s);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tsp_parser.h"
+
+/*
+    Embeddable solver
+
+    A solver owns a copy of its instance, its population, one PRNG per island and a thread pool
+    evolving the islands in parallel, so any number of solvers may run at once in one process.
+    Build the library with lib_compile.sh and link with -lga-tsp -lm -lpthread.
+
+        tsp_solver_params_t params = TSP_SOLVER_DEFAULTS;
+        params.islands = 4;
+        tsp_solver_t *s = tsp_solver_create(&instance, &params);
+        tsp_solver_run(s, 3000);
+        int64_t length = tsp_solver_best(s, tour);
+        tsp_solver_destroy(s);
+
+    A solver must not be used by two threads at once.
+*/
+
+typedef struct tsp_solver tsp_solver_t;
+
+typedef struct {
+    int population;     // total, divided evenly among the islands
+    int islands;        // each evolved by its own thread
+    int k;              // tournament size
+    int mutations;      // mutations / (1024*1024) = mutation chance
+    int op;             // mutation operator, index in tsp_mutation_ops
+    int migration;      // every this many generations islands cross, 0 for never
+    long seed;
+} tsp_solver_params_t;
+
+#define TSP_SOLVER_DEFAULTS ((tsp_solver_params_t) { .population = 2500, .islands = 1, .k = 4, .mutations = 1000, .op = 0, .migration = 0, .seed = 1 })
+
+// Creates a solver with a random population. Returns NULL if the instance has fewer than 2
+// cities or an island would have fewer than 2 solutions
+tsp_solver_t *tsp_solver_create(const tsp_2d_t *instance, const tsp_solver_params_t *params);
+
+// Evolves one generation, returns the number of generations evolved so far
+int tsp_solver_step(tsp_solver_t *solver);
+
+// Evolves gens generations, returns the number of generations evolved so far
+int tsp_solver_run(tsp_solver_t *solver, int gens);
+
+/* A change to the instance */
+typedef struct {
+    enum { TSP_DELTA_INSERT, TSP_DELTA_DELETE, TSP_DELTA_MOVE } type;
+    uint32_t city;      // city deleted or moved, an inserted city takes the next free index
+    double x, y;        // new coordinates when inserting or moving
+} tsp_delta_t;
+
+// Applies n changes to the solver's instance in order, keeping the population: deleted and moved
+// cities are taken out of every tour, and inserted and moved cities put back where they lengthen
+// the tour the least. Deleting a city gives the last city its index. Returns 0, or -1 without
+// changing anything if a delta names a city that doesn't exist or leaves fewer than 2 cities
+int tsp_solver_update(tsp_solver_t *solver, const tsp_delta_t *deltas, int n);
+
+// Number of cities of the solver's instance, which changes with tsp_solver_update
+size_t tsp_solver_dim(const tsp_solver_t *solver);
+
+// Returns the length of the best tour and writes it to tour unless tour is NULL
+int64_t tsp_solver_best(tsp_solver_t *solver, uint32_t *tour);
+
+void tsp_solver_destroy(tsp_solver_t *solver);
@@ -0,0 +1,285 @@
+#include "tour.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+void tour_init(tour_t *t, size_t n)
+{
+    t->n = n;
+    t->group = (size_t) sqrt((double) n);
+    if (t->group < 8)
+        t->group = 8;
+    // Every reversal adds at most two segments, rebuild once the initial count has doubled
+    t->cap = 2 * ((n + t->group - 1) / t->group) + 4;
+    t->order = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    t->pos = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    t->cseg = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    t->tmp = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    t->segs = (tour_seg_t *) malloc(sizeof(tour_seg_t) * t->cap);
+    t->seq = (uint32_t *) malloc(sizeof(uint32_t) * t->cap);
+    t->nseg = 0;
+}
+
+void tour_free(tour_t *t)
+{
+    free(t->order);
+    free(t->pos);
+    free(t->cseg);
+    free(t->tmp);
+    free(t->segs);
+    free(t->seq);
+}
+
+void tour_load(tour_t *t, const uint32_t *cities)
+{
+    if (cities != t->order)
+        memcpy(t->order, cities, sizeof(uint32_t) * t->n);
+
+    t->nseg = 0;
+    for (size_t lo = 0; lo < t->n; lo += t->group)
+    {
+        size_t hi = lo + t->group - 1;
+        if (hi >= t->n)
+            hi = t->n - 1;
+        t->segs[t->nseg] = (tour_seg_t) { .lo = lo, .hi = hi, .rank = t->nseg, .rev = 0, .moved = 0 };
+        t->seq[t->nseg] = t->nseg;
+        for (size_t i = lo; i <= hi; i++)
+        {
+            t->pos[t->order[i]] = i;
+            t->cseg[t->order[i]] = t->nseg;
+        }
+        t->nseg++;
+    }
+}
+
+void tour_store(tour_t *t, uint32_t *cities)
+{
+    size_t l = 0;
+    for (size_t r = 0; r < t->nseg; r++)
+    {
+        tour_seg_t *s = &t->segs[t->seq[r]];
+        if (s->rev)
+            for (int64_t i = s->hi; i >= (int64_t) s->lo; i--)
+                cities[l++] = t->order[i];
+        else
+            for (size_t i = s->lo; i <= s->hi; i++)
+                cities[l++] = t->order[i];
+    }
+}
+
+void tour_sync(tour_t *t, uint32_t *cities)
+{
+    size_t l = 0;
+    for (size_t r = 0; r < t->nseg; r++)
+    {
+        tour_seg_t *s = &t->segs[t->seq[r]];
+        if (!s->rev && !s->moved && s->lo == l)
+            l += s->hi - s->lo + 1;
+        else if (s->rev)
+            for (int64_t i = s->hi; i >= (int64_t) s->lo; i--)
+                cities[l++] = t->order[i];
+        else
+            for (size_t i = s->lo; i <= s->hi; i++)
+                cities[l++] = t->order[i];
+    }
+}
+
+// Position of c inside its segment, counted in tour direction
+static inline uint32_t inner(const tour_t *t, uint32_t c)
+{
+    const tour_seg_t *s = &t->segs[t->cseg[c]];
+    return s->rev ? s->hi - t->pos[c] : t->pos[c] - s->lo;
+}
+
+// Total order of the cities along the tour, starting at the first segment
+static inline uint64_t key(const tour_t *t, uint32_t c)
+{
+    return ((uint64_t) t->segs[t->cseg[c]].rank << 32) | inner(t, c);
+}
+
+static inline uint32_t first_of(const tour_t *t, uint32_t seg)
+{
+    const tour_seg_t *s = &t->segs[seg];
+    return t->order[s->rev ? s->hi : s->lo];
+}
+
+static inline uint32_t last_of(const tour_t *t, uint32_t seg)
+{
+    const tour_seg_t *s = &t->segs[seg];
+    return t->order[s->rev ? s->lo : s->hi];
+}
+
+uint32_t tour_next(const tour_t *t, uint32_t c)
+{
+    uint32_t sid = t->cseg[c];
+    const tour_seg_t *s = &t->segs[sid];
+    uint32_t p = t->pos[c];
+    if (!s->rev && p < s->hi)
+        return t->order[p + 1];
+    if (s->rev && p > s->lo)
+        return t->order[p - 1];
+    return first_of(t, t->seq[(s->rank + 1) % t->nseg]);
+}
+
+uint32_t tour_prev(const tour_t *t, uint32_t c)
+{
+    uint32_t sid = t->cseg[c];
+    const tour_seg_t *s = &t->segs[sid];
+    uint32_t p = t->pos[c];
+    if (!s->rev && p > s->lo)
+        return t->order[p - 1];
+    if (s->rev && p < s->hi)
+        return t->order[p + 1];
+    return last_of(t, t->seq[(s->rank + t->nseg - 1) % t->nseg]);
+}
+
+int tour_between(const tour_t *t, uint32_t a, uint32_t b, uint32_t c)
+{
+    uint64_t ka = key(t, a), kb = key(t, b), kc = key(t, c);
+    if (ka <= kc)
+        return ka <= kb && kb <= kc;
+    return kb >= ka || kb <= kc;
+}
+
+// Splits the segment of c so that c becomes its first city
+static void split_before(tour_t *t, uint32_t c)
+{
+    uint32_t sid = t->cseg[c];
+    tour_seg_t *s = &t->segs[sid];
+    if (first_of(t, sid) == c)
+        return;
+
+    uint32_t p = t->pos[c];
+    uint32_t nid = t->nseg++;
+    tour_seg_t *ns = &t->segs[nid];
+    ns->rev = s->rev;
+    ns->moved = s->moved;
+    if (!s->rev)
+    {
+        ns->lo = p;
+        ns->hi = s->hi;
+        s->hi = p - 1;
+    }
+    else
+    {
+        ns->lo = s->lo;
+        ns->hi = p;
+        s->lo = p + 1;
+    }
+    for (uint32_t i = ns->lo; i <= ns->hi; i++)
+        t->cseg[t->order[i]] = nid;
+
+    // The new segment follows the old one
+    uint32_t r = s->rank + 1;
+    memmove(&t->seq[r + 1], &t->seq[r], sizeof(uint32_t) * (t->nseg - 1 - r));
+    t->seq[r] = nid;
+    for (uint32_t i = r; i < t->nseg; i++)
+        t->segs[t->seq[i]].rank = i;
+}
+
+// Reverses the segments with ranks in [lo, hi]
+static void reverse_segments(tour_t *t, uint32_t lo, uint32_t hi)
+{
+    while (lo < hi)
+    {
+        uint32_t aux = t->seq[lo];
+        t->seq[lo] = t->seq[hi];
+        t->seq[hi] = aux;
+        lo++;
+        hi--;
+    }
+}
+
+void tour_reverse(tour_t *t, uint32_t a, uint32_t b)
+{
+    if (a == b || tour_next(t, b) == a)
+        return;
+
+    // Short path inside one segment, reverse the cities in place
+    uint32_t sid = t->cseg[a];
+    if (sid == t->cseg[b] && inner(t, a) < inner(t, b))
+    {
+        uint32_t lo = t->pos[a], hi = t->pos[b];
+        if (lo > hi)
+        {
+            uint32_t aux = lo;
+            lo = hi;
+            hi = aux;
+        }
+        t->segs[sid].moved = 1;
+        while (lo < hi)
+        {
+            uint32_t x = t->order[lo], y = t->order[hi];
+            t->order[lo] = y;
+            t->order[hi] = x;
+            t->pos[y] = lo++;
+            t->pos[x] = hi--;
+        }
+        return;
+    }
+
+    if (t->nseg + 2 > t->cap)
+    {
+        tour_store(t, t->tmp);
+        memcpy(t->order, t->tmp, sizeof(uint32_t) * t->n);
+        tour_load(t, t->order);
+        for (size_t i = 0; i < t->nseg; i++)
+            t->segs[i].moved = 1;
+    }
+
+    split_before(t, a);
+    split_before(t, tour_next(t, b));
+
+    uint32_t ra = t->segs[t->cseg[a]].rank;
+    uint32_t rb = t->segs[t->cseg[b]].rank;
+    uint32_t lo = ra, hi = rb;
+    if (ra > rb)
+    {
+        // The path wraps around the end of seq, its complement does not
+        lo = rb + 1;
+        hi = ra - 1;
+    }
+
+    reverse_segments(t, lo, hi);
+    for (uint32_t i = lo; i <= hi; i++)
+    {
+        tour_seg_t *s = &t->segs[t->seq[i]];
+        s->rev ^= 1;
+        s->rank = i;
+    }
+}
+
+void tour_2opt_move(tour_t *t, uint32_t x1, uint32_t x2, uint32_t y1, uint32_t y2)
+{
+    if (tour_next(t, x1) == x2)
+        tour_reverse(t, x2, y1);
+    else
+        tour_reverse(t, x1, y2);
+}
+
+void tour_or_move(tour_t *t, uint32_t s1, uint32_t s2, uint32_t c, int rev)
+{
+    uint32_t p = tour_prev(t, s1), n = tour_next(t, s2);
+    uint32_t d = tour_next(t, c);
+
+    // p c .. n s2 .. s1 d
+    tour_2opt_move(t, p, s1, c, d);
+    // p n .. c s2 .. s1 d
+    if (c != n)
+        tour_2opt_move(t, p, c, n, s2);
+    // c s1 .. s2 d
+    if (!rev && s1 != s2)
+        tour_2opt_move(t, c, s2, s1, d);
+}
+
+void tour_double_bridge(tour_t *t, uint32_t b1, uint32_t c1, uint32_t d1)
+{
+    uint32_t a2 = tour_prev(t, b1), b2 = tour_prev(t, c1), c2 = tour_prev(t, d1);
+
+    // a2 c2 .. c1 b2 .. b1 d1
+    tour_2opt_move(t, a2, b1, c2, d1);
+    // a2 c1 .. c2 b2 .. b1 d1
+    tour_2opt_move(t, a2, c2, c1, b2);
+    // a2 c1 .. c2 b1 .. b2 d1
+    tour_2opt_move(t, c2, b2, b1, d1);
+}
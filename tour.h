@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Tour representation supporting O(sqrt n) path reversals
+
+    The tour is split into segments of about sqrt(n) cities. Each segment owns a contiguous range
+    of the order array and has an orientation bit, and the segments themselves are kept in tour
+    order in seq. Reversing a path splits at most two segments, then reverses the run of whole
+    segments between them by flipping their bits. When too many segments accumulate the tour is
+    rebuilt with even segments.
+
+    Orientation is not preserved: a reversal may be applied to the complementary path, which
+    yields the same cycle traversed the other way. Moves should therefore be expressed with
+    tour_2opt_move, which looks up successors at the time it is called.
+*/
+
+typedef struct {
+    uint32_t lo, hi;    // range in order, inclusive
+    uint32_t rank;      // index in seq
+    uint8_t rev;        // if set the range is traversed from hi to lo
+    uint8_t moved;      // set once the range no longer holds the cities it was loaded with
+} tour_seg_t;
+
+typedef struct {
+    size_t n, group;
+    uint32_t *order;    // cities, grouped by segment
+    uint32_t *pos;      // city -> index in order
+    uint32_t *cseg;     // city -> segment
+    uint32_t *tmp;      // scratch for rebuilding
+    tour_seg_t *segs;
+    uint32_t *seq;      // segment ids in tour order
+    size_t nseg, cap;
+} tour_t;
+
+void tour_init(tour_t *t, size_t n);
+
+void tour_free(tour_t *t);
+
+// Loads a permutation of [0, n) as the tour
+void tour_load(tour_t *t, const uint32_t *cities);
+
+// Writes the tour as a permutation starting with the city at the start of the first segment
+void tour_store(tour_t *t, uint32_t *cities);
+
+// Same as tour_store into the permutation the tour was loaded from, skipping the segments still
+// in their place, so that only the paths moves changed are written back
+void tour_sync(tour_t *t, uint32_t *cities);
+
+uint32_t tour_next(const tour_t *t, uint32_t c);
+
+uint32_t tour_prev(const tour_t *t, uint32_t c);
+
+// 1 if b lies on the path from a forward to c, inclusive
+int tour_between(const tour_t *t, uint32_t a, uint32_t b, uint32_t c);
+
+// Reverses the path from a forward to b
+void tour_reverse(tour_t *t, uint32_t a, uint32_t b);
+
+// Replaces edges (x1,x2) and (y1,y2) with (x1,y1) and (x2,y2). Both edges must point the same
+// way around the tour, i.e. x2 follows x1 exactly when y2 follows y1
+void tour_2opt_move(tour_t *t, uint32_t x1, uint32_t x2, uint32_t y1, uint32_t y2);
+
+// Moves the path from s1 forward to s2 between c and its successor, so that c is followed by s1,
+// or by s2 if rev is set. c must lie outside the path and must not be the predecessor of s1
+void tour_or_move(tour_t *t, uint32_t s1, uint32_t s2, uint32_t c, int rev);
+
+// Exchanges the paths starting at b1 and c1 ending right before c1 and d1 respectively.
+// b1, c1 and d1 must be distinct and in tour order
+void tour_double_bridge(tour_t *t, uint32_t b1, uint32_t c1, uint32_t d1);
@@ -1,24 +1,96 @@
 #include "tsp.h"
+#include "genetic_engine.h"
 #include "tsp_parser.h"
+#include "prof.h"
+#include "tour.h"
+#include "diversity.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
-extern tsp_2d_t tsp;
-extern int mutations;
-extern struct drand48_data *rbufs;
+tsp_context_t tsp_default = {0};
+static __thread const tsp_context_t *local = NULL;
+static pthread_key_t segments;          // segmented tour kept by each thread for its mutations
+static pthread_once_t segments_once = PTHREAD_ONCE_INIT;
+
+void tsp_set_local(const tsp_context_t *ctx)
+{
+    local = ctx;
+}
+
+static inline const tsp_context_t *context(void)
+{
+    return local ? local : &tsp_default;
+}
+
+static void free_segments(void *t)
+{
+    tour_free((tour_t *) t);
+    free(t);
+}
+
+static void create_segments(void)
+{
+    pthread_key_create(&segments, free_segments);
+}
+
+// Segmented tour of the calling thread sized for len cities, kept until the thread exits and
+// reallocated only when len changes
+static tour_t *thread_tour(size_t len)
+{
+    pthread_once(&segments_once, create_segments);
+    tour_t *t = (tour_t *) pthread_getspecific(segments);
+    if (!t)
+    {
+        t = (tour_t *) malloc(sizeof(tour_t));
+        tour_init(t, len);
+        pthread_setspecific(segments, t);
+    }
+    else if (t->n != len)
+    {
+        tour_free(t);
+        tour_init(t, len);
+    }
+    return t;
+}
+
+static inline uint32_t *tour_of(ga_solution_t *sol, int write)
+{
+    const tsp_context_t *ctx = context();
+    return ctx->pack ? pack_open(ctx->pack, sol, write) : (uint32_t *) sol->chromosome;
+}
+
+// Tour of sol to read without keeping it unpacked
+static inline const uint32_t *peek(const ga_solution_t *sol)
+{
+    const tsp_context_t *ctx = context();
+    return ctx->pack ? pack_peek(ctx->pack, sol) : (const uint32_t *) sol->chromosome;
+}
+
+uint32_t *tsp_tour(ga_solution_t *sol, int write)
+{
+    return tour_of(sol, write);
+}
+
+void tsp_pack_flush(void)
+{
+    if (context()->pack)
+        pack_flush(context()->pack);
+}
 
 // Initializes a random solution
 void generate_tsp_solution(ga_solution_t *sol, size_t i, size_t chrom_len, void *chrom_chunk, uint8_t *marks)
 {
     uint32_t *chromosome = (uint32_t *) chrom_chunk + i * chrom_len;
     // uint8_t *marks = (uint8_t *) malloc(sizeof(uint8_t) * chrom_len);
+    struct drand48_data *rbuf = context()->rbuf;
     memset(marks, 0, sizeof(uint8_t) * chrom_len);
 
     for (size_t j = chrom_len; j; j--)
     {
         long n;
-        lrand48_r(&rbufs[0], &n);
+        lrand48_r(rbuf, &n);
         size_t r = n % j;
         size_t l = 0;
         while (marks[l] || r)
@@ -48,19 +120,40 @@ int64_t fitness(ga_solution_t *sol)
     int64_t d = 0;
     if (sol->fit_gen)
         return sol->fitness;
-    for (int i = 0; i < sol->chrom_len; i++)
+    PROF_START(t);
+    const tsp_context_t *ctx = context();
+    if (ctx->backbone)
     {
-        int j = (i + 1) % sol->chrom_len;
-        d += round(dist(tsp.nodes[((uint32_t *) sol->chromosome)[i]],
-                        tsp.nodes[((uint32_t *) sol->chromosome)[j]]));
+        sol->fitness = backbone_length(ctx->backbone, ctx->instance, peek(sol));
+        sol->fit_gen = 1;
+        PROF_STOP(t, PROF_FITNESS);
+        return sol->fitness;
     }
+    const uint32_t *tour = peek(sol);
+    if (ctx->coords)
+        d = coords_length(ctx->coords, tour, sol->chrom_len);
+    else
+        for (int i = 0; i < sol->chrom_len; i++)
+        {
+            int j = (i + 1) % sol->chrom_len;
+            d += tsp_round_dist(ctx->instance, tour[i], tour[j]);
+        }
     sol->fitness = d;
     sol->fit_gen = 1;
+    PROF_STOP(t, PROF_FITNESS);
     return d;
 }
 
-// Cross two solutions and produce a child solution with traits from both parents 
-void crossover(ga_solution_t *p1, ga_solution_t *p2, ga_solution_t *child, uint8_t *marks, struct drand48_data *rbuf)
+// Rotation and direction invariant hash of the tour's edges
+uint64_t tsp_hash(ga_solution_t *sol)
+{
+    return div_tour_hash(peek(sol), sol->chrom_len);
+}
+
+// Cross two solutions and produce a child solution with traits from both parents. Near-identical
+// parents get a burst of the island's own mutation operator
+static inline void cross(ga_solution_t *p1, ga_solution_t *p2, ga_solution_t *child, uint8_t *marks, struct drand48_data *rbuf,
+                         void (*mutation_func)(ga_solution_t *, int, struct drand48_data *))
 {
     // Take half of the chromosome of one parent, then the remaining half of the other such that
     // nodes don't repeat
@@ -71,38 +164,66 @@ void crossover(ga_solution_t *p1, ga_solution_t *p2, ga_solution_t *child, uint8
     int l = p1->chrom_len / 2;
 
     memset(marks, 0, p1->chrom_len);
+    const uint32_t *t1 = tour_of(p1, 0), *t2 = tour_of(p2, 0);
+    uint32_t *tc = tour_of(child, 1);
+    child->hash = 0;
 
     // Copy half from parent 1
     for (int i = 0; i < l; i++)
     {
-        uint32_t n = ((uint32_t *) p1->chromosome)[start + i];
-        ((uint32_t *) child->chromosome)[i] = n;
+        uint32_t n = t1[start + i];
+        tc[i] = n;
         marks[n] = 1;
     }
 
     // Copy remaining
     for (int i = 0; i < p1->chrom_len; i++)
     {
-        uint32_t n = ((uint32_t *) p2->chromosome)[i];
+        uint32_t n = t2[i];
         if (marks[n])
             continue;
 
-        ((uint32_t *) child->chromosome)[l++] = n;
+        tc[l++] = n;
     }
 
     // If solutions are very similar apply some high mutation rate
     int diff = 0;
     for (int i = 0; i < p1->chrom_len; i++)
-        if (((uint32_t *) p1->chromosome)[i] != ((uint32_t *) p2->chromosome)[i])
+        if (t1[i] != t2[i])
             diff++;
 
     // If parents are less than 5% different
     if (diff <= p1->chrom_len / 20)
-        mutate(child, mutations * 20, rbuf); // 15 times as likely to have mutations
+        mutation_func(child, context()->mutations * 20, rbuf); // 15 times as likely to have mutations
     // ^ This is not what happens in real life, but it gives better results in this case
 }
 
-// Apply random swaps of genes dictated by some small chance
+void crossover(ga_solution_t *p1, ga_solution_t *p2, ga_solution_t *child, uint8_t *marks, struct drand48_data *rbuf)
+{
+    cross(p1, p2, child, marks, rbuf, mutate);
+}
+
+static void crossover_segment(ga_solution_t *p1, ga_solution_t *p2, ga_solution_t *child, uint8_t *marks, struct drand48_data *rbuf)
+{
+    cross(p1, p2, child, marks, rbuf, mutate_segment);
+}
+
+// XOR of the hashes of the edges leaving the given positions of tour, each position once
+static uint64_t edges_from(const uint32_t *tour, size_t n, const uint32_t *at, int count)
+{
+    uint64_t h = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int seen = 0;
+        for (int j = 0; j < i; j++)
+            seen |= at[j] == at[i];
+        if (!seen)
+            h ^= div_edge_hash(tour[at[i]], tour[(at[i] + 1) % n]);
+    }
+    return h;
+}
+
+// Apply random swaps of genes dictated by some small chance. A computed hash is kept up to date
 void mutate(ga_solution_t *sol, int per_Mi, struct drand48_data *rbuf)
 {
     // 1024*1024 - 1
@@ -111,12 +232,14 @@ void mutate(ga_solution_t *sol, int per_Mi, struct drand48_data *rbuf)
     int per_Mi2 = 3 * per_Mi / 4 + 1;
     long n, n2;
     lrand48_r(rbuf, &n);
+    uint32_t *tour = (n & 0xFFFFF) < per_Mi ? tour_of(sol, 1) : NULL;
     while ((n & 0xFFFFF) < per_Mi)
     {
+        PROF_COUNT(mutations, 1);
         n2 = n;
         lrand48_r(rbuf, &n);
         uint32_t i = n % sol->chrom_len;
-        uint32_t aux = ((uint32_t*)sol->chromosome)[i];
+        uint32_t aux = tour[i];
         lrand48_r(rbuf, &n);
 
         uint32_t j;
@@ -126,40 +249,262 @@ void mutate(ga_solution_t *sol, int per_Mi, struct drand48_data *rbuf)
         else 
             j = n % sol->chrom_len;
 
+        // Edges leaving the swapped positions and those before them change
+        uint32_t len = sol->chrom_len;
+        uint32_t at[6] = { (i + len - 1) % len, i, (j + len - 1) % len, j };
+        int count = 4;
+
         // Sometimes do 2-swap
         if ((n & 0xF) < 0xA)
         {
-            ((uint32_t*)sol->chromosome)[i] = ((uint32_t*)sol->chromosome)[j];
-            ((uint32_t*)sol->chromosome)[j] = aux;
+            if (sol->hash)
+                sol->hash ^= edges_from(tour, len, at, count);
+            tour[i] = tour[j];
+            tour[j] = aux;
         } else // other times to 3-swap
         {
             lrand48_r(rbuf, &n);
             uint32_t k = n % sol->chrom_len;
-            ((uint32_t*)sol->chromosome)[i] = ((uint32_t*)sol->chromosome)[j];
-            ((uint32_t*)sol->chromosome)[j] = ((uint32_t*)sol->chromosome)[k];
-            ((uint32_t*)sol->chromosome)[k] = aux;
+            at[count++] = (k + len - 1) % len;
+            at[count++] = k;
+            if (sol->hash)
+                sol->hash ^= edges_from(tour, len, at, count);
+            tour[i] = tour[j];
+            tour[j] = tour[k];
+            tour[k] = aux;
+        }
+        if (sol->hash)
+            sol->hash ^= edges_from(tour, len, at, count);
+    }
+}
+
+// Double bridge kick at random cut points, taken in tour order. Updates *hash unless it is 0
+static void double_bridge(tour_t *t, uint32_t len, struct drand48_data *rbuf, uint64_t *hash)
+{
+    long r1, r2, r3;
+    lrand48_r(rbuf, &r1);
+    lrand48_r(rbuf, &r2);
+    lrand48_r(rbuf, &r3);
+    uint32_t b1 = r1 % len, c1 = r2 % len, d1 = r3 % len;
+    if (b1 != c1 && c1 != d1 && b1 != d1)
+    {
+        if (!tour_between(t, b1, c1, d1))
+        {
+            uint32_t aux = c1;
+            c1 = d1;
+            d1 = aux;
         }
+        if (*hash)
+        {
+            // a2 b1 .. b2 c1 .. c2 d1 becomes a2 c1 .. c2 b1 .. b2 d1
+            uint32_t a2 = tour_prev(t, b1), b2 = tour_prev(t, c1), c2 = tour_prev(t, d1);
+            *hash = div_hash_replace(*hash, a2, b1, a2, c1);
+            *hash = div_hash_replace(*hash, b2, c1, c2, b1);
+            *hash = div_hash_replace(*hash, c2, d1, b2, d1);
+        }
+        tour_double_bridge(t, b1, c1, d1);
     }
 }
 
-void verify_tsp_solutions(ga_solution_t *sol, size_t size, struct drand48_data *rbuf)
+// Apply Or-opt moves of short paths and occasional double-bridge kicks, dictated by some small
+// chance. The tour is loaded into a segmented representation so each move costs O(sqrt n)
+void mutate_segment(ga_solution_t *sol, int per_Mi, struct drand48_data *rbuf)
+{
+    per_Mi &= 0xFFFFF;
+    long n;
+    lrand48_r(rbuf, &n);
+    if ((n & 0xFFFFF) >= per_Mi || sol->chrom_len < 8)
+        return;
+
+    uint32_t len = sol->chrom_len;
+    uint32_t *tour = tour_of(sol, 1);
+    tour_t *t = thread_tour(len);
+    tour_load(t, tour);
+
+    do
+    {
+        PROF_COUNT(mutations, 1);
+        lrand48_r(rbuf, &n);
+        if ((n & 0x7) == 0)
+            double_bridge(t, len, rbuf, &sol->hash);
+        else
+        {
+            // Or-opt, move a path of 1 to 3 cities
+            long r;
+            lrand48_r(rbuf, &r);
+            uint32_t s1 = r % len, s2 = s1;
+            for (int i = (n >> 3) % 3; i > 0; i--)
+                s2 = tour_next(t, s2);
+            uint32_t p = tour_prev(t, s1), c = tour_next(t, s2);
+
+            // Most times insert it a few cities further along, otherwise anywhere
+            lrand48_r(rbuf, &r);
+            if ((r & 0x3) != 0)
+                for (int i = (r >> 2) % 32; i > 0 && c != p; i--)
+                    c = tour_next(t, c);
+            else
+                c = (r >> 2) % len;
+
+            if (c != p && !tour_between(t, s1, c, s2))
+            {
+                int rev = (n >> 5) & 1;
+                if (sol->hash)
+                {
+                    // p s1 .. s2 x .. c d becomes p x .. c s1 .. s2 d, the path reversed if rev
+                    uint32_t x = tour_next(t, s2), d = tour_next(t, c);
+                    sol->hash = div_hash_replace(sol->hash, p, s1, p, x);
+                    sol->hash = div_hash_replace(sol->hash, s2, x, c, rev ? s2 : s1);
+                    sol->hash = div_hash_replace(sol->hash, c, d, rev ? s1 : s2, d);
+                }
+                tour_or_move(t, s1, s2, c, rev);
+            }
+        }
+        lrand48_r(rbuf, &n);
+    } while ((n & 0xFFFFF) < per_Mi);
+
+    // Only the paths the moves changed are written back
+    tour_sync(t, tour);
+}
+
+void (*const tsp_mutation_ops[TSP_MUTATIONS])(ga_solution_t *, int, struct drand48_data *) = { mutate, mutate_segment };
+const char *const tsp_mutation_names[TSP_MUTATIONS] = { "swap", "segment" };
+void (*const tsp_crossover_ops[TSP_MUTATIONS])(ga_solution_t *, ga_solution_t *, ga_solution_t *, uint8_t *, struct drand48_data *) = { crossover, crossover_segment };
+
+int tsp_mutation_find(const char *name)
 {
-    uint8_t *marks = (uint8_t *) malloc(sizeof(uint8_t) * sol->chrom_len);
-    for (int i = 0; i < size; i++)
+    for (int i = 0; i < TSP_MUTATIONS; i++)
+        if (strcmp(name, tsp_mutation_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+#define TSP_ENGINE(name, crossover_func, mutation_func) \
+    static int name(ga_solution_t *pop, size_t size, int k, int mutation_per_Mi, struct drand48_data *rbuf, ga_ext_t *ext) \
+    { \
+        int gen = ga_tournament_engine(pop, size, k, GA_MINIMIZE, fitness, crossover_func, mutation_per_Mi, mutation_func, rbuf, ext); \
+        tsp_pack_flush(); \
+        return gen; \
+    }
+
+TSP_ENGINE(engine_swap, crossover, mutate)
+TSP_ENGINE(engine_segment, crossover_segment, mutate_segment)
+
+const tsp_engine_t tsp_engines[TSP_MUTATIONS] = { engine_swap, engine_segment };
+
+void tsp_seed_population(ga_solution_t *pop, size_t size, uint32_t *const *tours, int ntours, int percent, struct drand48_data *rbuf)
+{
+    if (ntours < 1 || size == 0)
+        return;
+    size_t seeded = size * percent / 100;
+    if (seeded < ntours)
+        seeded = ntours < size ? ntours : size;
+
+    uint32_t len = pop->chrom_len;
+    tour_t *t = len >= 8 ? thread_tour(len) : NULL;
+    for (size_t i = 0; i < seeded; i++)
     {
-        for (int j = 0; j < sol->chrom_len; j++)
-            marks[j] = 0;
+        uint32_t *tour = tour_of(&pop[i], 1);
+        memcpy(tour, tours[i % ntours], sizeof(uint32_t) * len);
+        pop[i].fit_gen = 0;
+        pop[i].hash = 0;
+        if (i < ntours || len < 8)
+            continue;
 
-        for (int j = 0; j < sol->chrom_len; j++)
+        // Copies get 1 to 4 kicks, staying close to the tour without being clones of it
+        long n;
+        lrand48_r(rbuf, &n);
+        tour_load(t, tour);
+        for (int k = n % 4; k >= 0; k--)
+            double_bridge(t, len, rbuf, &pop[i].hash);
+        tour_sync(t, tour);
+    }
+    tsp_pack_flush();
+}
+
+tsp_fingerprint_t tsp_fingerprint(const uint32_t *tour, size_t len)
+{
+    uint32_t sum = 0, squares = 0, xor = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        sum += tour[i];
+        squares += tour[i] * tour[i];
+        xor ^= tour[i];
+    }
+    return (tsp_fingerprint_t) { sum, squares, xor };
+}
+
+static inline int fingerprint_equal(tsp_fingerprint_t a, tsp_fingerprint_t b)
+{
+    return a.sum == b.sum && a.squares == b.squares && a.xor == b.xor;
+}
+
+size_t tsp_repair(uint32_t *tour, size_t len, uint8_t *marks)
+{
+    memset(marks, 0, sizeof(uint8_t) * len);
+    size_t kept = 0;
+    for (size_t i = 0; i < len; i++)
+        if (tour[i] < len && !marks[tour[i]])
         {
-            if (marks[((uint32_t *) sol[i].chromosome)[j]])
+            marks[tour[i]] = 1;
+            tour[kept++] = tour[i];
+        }
+    size_t missing = len - kept;
+
+    const tsp_2d_node_t *nodes = context()->instance->nodes;
+    for (uint32_t city = 0; city < len; city++)
+    {
+        if (marks[city])
+            continue;
+        size_t best = kept;
+        double best_cost = 0;
+        for (size_t i = 0; i < kept; i++)
+        {
+            uint32_t a = tour[i], b = tour[(i + 1) % kept];
+            double cost = dist(nodes[a], nodes[city]) + dist(nodes[city], nodes[b]) - dist(nodes[a], nodes[b]);
+            if (best == kept || cost < best_cost)
             {
-                generate_tsp_solution(&sol[i], 1, sol->chrom_len, sol[i].chromosome, marks);
-                break;
+                best = i + 1;
+                best_cost = cost;
             }
-            marks[((uint32_t *) sol[i].chromosome)[j]] = 1;
+        }
+        memmove(tour + best + 1, tour + best, sizeof(uint32_t) * (kept - best));
+        tour[best] = city;
+        kept++;
+    }
+    return missing;
+}
+
+size_t verify_tsp_solutions(ga_solution_t *sol, size_t size, const tsp_fingerprint_t *sent, const tsp_fingerprint_t *received)
+{
+    if (!size)
+        return 0;
+    size_t len = sol->chrom_len, repaired = 0;
+    tsp_fingerprint_t perm = {0};
+    for (uint32_t j = 0; j < len; j++)
+    {
+        perm.sum += j;
+        perm.squares += j * j;
+        perm.xor ^= j;
+    }
+
+    // Only tours whose fingerprint differs get the full check
+    uint8_t *marks = NULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        tsp_fingerprint_t f = received ? received[i] : tsp_fingerprint(tour_of(&sol[i], 0), len);
+        if (fingerprint_equal(f, perm) && fingerprint_equal(f, sent[i]))
+            continue;
+        if (!marks)
+            marks = (uint8_t *) malloc(sizeof(uint8_t) * len);
+        if (tsp_repair(tour_of(&sol[i], 1), len, marks))
+        {
+            sol[i].fit_gen = 0;
+            sol[i].hash = 0;
+            repaired++;
         }
     }
     free(marks);
+    tsp_pack_flush();
+    return repaired;
 }
 
@@ -2,8 +2,35 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <math.h>
 #include "genetic.h"
 #include "tsp_parser.h"
+#include "backbone.h"
+#include "pack.h"
+#include "coords.h"
+
+/* What the operators use besides their arguments. Each thread uses the context it set with
+   tsp_set_local, or tsp_default if it set none, so several instances can be solved at once */
+typedef struct {
+    const tsp_2d_t *instance;
+    struct drand48_data *rbuf;  // for new random solutions
+    int mutations;              // mutation rate crossover raises for near-identical parents
+    const backbone_t *backbone; // if set chromosomes are tours of its nodes instead of cities
+    const pack_t *pack;         // if set chromosomes are records packed against its references
+    const coords_t *coords;     // if set fitness measures tours with it, in its precision
+} tsp_context_t;
+
+extern tsp_context_t tsp_default;
+
+// Makes the calling thread's operators use ctx, NULL restores tsp_default
+void tsp_set_local(const tsp_context_t *ctx);
+
+// Tour of sol, unpacked into a slot of the calling thread if the population is packed, in which
+// case write must be set to keep changes to it, and tsp_pack_flush releases it
+uint32_t *tsp_tour(ga_solution_t *sol, int write);
+
+// Packs back the tours the calling thread unpacked, does nothing if the population isn't packed
+void tsp_pack_flush(void);
 
 // Initializes a random solution
 void generate_tsp_solution(ga_solution_t *sol, size_t i, size_t chrom_len, void *chrom_chunk, uint8_t *marks);
@@ -11,14 +38,66 @@ void generate_tsp_solution(ga_solution_t *sol, size_t i, size_t chrom_len, void
 // Euclidean distance
 double dist(const tsp_2d_node_t a, const tsp_2d_node_t b);
 
+// Distance between cities a and b of tsp rounded to the nearest integer, as tour lengths are
+static inline int64_t tsp_round_dist(const tsp_2d_t *tsp, uint32_t a, uint32_t b)
+{
+    return round(dist(tsp->nodes[a], tsp->nodes[b]));
+}
+
 // Distance based fitness
 int64_t fitness(ga_solution_t *sol);
 
-// Cross two solutions and produce a child solution with traits from both parents 
+// Rotation and direction invariant hash of the tour's edges
+uint64_t tsp_hash(ga_solution_t *sol);
+
+// Cross two solutions and produce a child solution with traits from both parents. Near-identical
+// parents get a burst of swap mutations
 void crossover(ga_solution_t *p1, ga_solution_t *p2, ga_solution_t *child, uint8_t *marks, struct drand48_data *rbuf);
 
-// Apply random swaps of genes dictated by some small chance
+// Apply random swaps of genes dictated by some small chance. A computed hash is kept up to date
 void mutate(ga_solution_t *sol, int per_Mi, struct drand48_data *rbuf);
 
-void verify_tsp_solutions(ga_solution_t *sol, size_t i, struct drand48_data *rbuf);
+// Apply random Or-opt moves and double-bridge kicks dictated by some small chance. A computed
+// hash is kept up to date
+void mutate_segment(ga_solution_t *sol, int per_Mi, struct drand48_data *rbuf);
+
+#define TSP_MUTATIONS 2
+
+// Mutation operators selectable by name
+extern void (*const tsp_mutation_ops[TSP_MUTATIONS])(ga_solution_t *, int, struct drand48_data *);
+extern const char *const tsp_mutation_names[TSP_MUTATIONS];
+
+// crossover with the burst for near-identical parents made of the mutation operator of the same
+// index in tsp_mutation_ops
+extern void (*const tsp_crossover_ops[TSP_MUTATIONS])(ga_solution_t *, ga_solution_t *, ga_solution_t *, uint8_t *, struct drand48_data *);
+
+// Index of the mutation operator called name, -1 if there is none
+int tsp_mutation_find(const char *name);
+
+// ga_next_generation_tournament minimizing with fitness and the crossover and mutation operators
+// of the same index in tsp_crossover_ops and tsp_mutation_ops, bound at compile time so the operators can be inlined
+typedef int (*tsp_engine_t)(ga_solution_t *pop, size_t size, int k, int mutation_per_Mi, struct drand48_data *rbuf, ga_ext_t *ext);
+extern const tsp_engine_t tsp_engines[TSP_MUTATIONS];
+
+// Replaces percent of the population, at least one solution per tour, with the given tours: each
+// tour once as it is, then copies perturbed by a few double-bridge kicks
+void tsp_seed_population(ga_solution_t *pop, size_t size, uint32_t *const *tours, int ntours, int percent, struct drand48_data *rbuf);
+
+/* Order independent fingerprint of a tour's cities, modulo 2^32. Every permutation of the same
+   cities has the same one, and a tour with a repeated city almost never has a permutation's */
+typedef struct {
+    uint32_t sum, squares, xor;
+} tsp_fingerprint_t;
+
+tsp_fingerprint_t tsp_fingerprint(const uint32_t *tour, size_t len);
+
+// Makes tour a permutation of 0 .. len - 1 again: repeated and out of range cities are dropped and
+// the missing ones inserted where they lengthen the tour the least. Returns the number of cities
+// inserted, 0 if tour was already a permutation. marks holds len bytes
+size_t tsp_repair(uint32_t *tour, size_t len, uint8_t *marks);
+
+// Repairs the received solutions whose fingerprint differs from the one their sender computed, or
+// from a permutation's. received holds the solutions' fingerprints if they were already computed,
+// NULL to compute them here. Returns the number of solutions repaired
+size_t verify_tsp_solutions(ga_solution_t *sol, size_t size, const tsp_fingerprint_t *sent, const tsp_fingerprint_t *received);
 
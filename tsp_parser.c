@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 /*`
 typedef struct tsp_2d_t {
@@ -104,3 +105,234 @@ void tsp_2d_free(tsp_2d_t tsp)
 {
     free(tsp.nodes);
 }
+
+// Checks that tour visits each of the dim cities once
+static int is_permutation(const uint32_t *tour, size_t dim)
+{
+    char *seen = (char *) calloc(dim, sizeof(char));
+    size_t i = 0;
+    for (; i < dim && tour[i] < dim && !seen[tour[i]]; i++)
+        seen[tour[i]] = 1;
+    free(seen);
+    return i == dim;
+}
+
+int tsp_tour_read(const char *filename, size_t dim, uint32_t *tour)
+{
+    FILE *fd = fopen(filename, "rb");
+    if (!fd)
+        return -1;
+
+    char buf[BUFSIZ], *tok;
+    size_t n = 0;
+    int section = 0;
+
+    // TSPLIB: keywords up to TOUR_SECTION, then one index per line up to -1
+    while (fgets(buf, sizeof(buf), fd))
+    {
+        if (!section)
+        {
+            if (!(tok = strtok(buf, " :\t\r\n")))
+                continue;
+            if (strcmp(tok, "DIMENSION") == 0 && (!(tok = strtok(NULL, " :\t\r\n")) || atol(tok) != dim))
+            {
+                fclose(fd);
+                return -1;
+            }
+            if (strcmp(tok, "TOUR_SECTION") == 0)
+                section = 1;
+            continue;
+        }
+
+        long city = 0;
+        for (tok = strtok(buf, " \t\r\n"); tok && (city = atol(tok)) > 0 && n < dim; tok = strtok(NULL, " \t\r\n"))
+            tour[n++] = city - 1;
+        if (city < 0 || n == dim)
+            break;
+    }
+
+    // Otherwise a binary tour, exactly dim indices long
+    if (!section)
+    {
+        rewind(fd);
+        n = fread(tour, sizeof(uint32_t), dim, fd);
+        if (getc(fd) != EOF)
+            n = 0;
+    }
+    fclose(fd);
+
+    return n == dim && is_permutation(tour, dim) ? 0 : -1;
+}
+
+#define HILBERT_BITS 16
+
+// Distance along the Hilbert curve filling a 2^HILBERT_BITS square to the point (x, y)
+static uint64_t hilbert_index(uint32_t x, uint32_t y)
+{
+    const uint32_t n = 1u << HILBERT_BITS;
+    uint64_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2)
+    {
+        uint32_t rx = (x & s) > 0, ry = (y & s) > 0;
+        d += (uint64_t) s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the curve continues in the same orientation
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            uint32_t aux = x;
+            x = y;
+            y = aux;
+        }
+    }
+    return d;
+}
+
+typedef struct {
+    uint64_t key;
+    uint32_t city;
+} hilbert_key_t;
+
+static int hilbert_cmp(const void *a, const void *b)
+{
+    const hilbert_key_t *ka = (const hilbert_key_t *) a, *kb = (const hilbert_key_t *) b;
+    if (ka->key != kb->key)
+        return ka->key < kb->key ? -1 : 1;
+    return (ka->city > kb->city) - (ka->city < kb->city);
+}
+
+uint32_t *tsp_2d_hilbert(tsp_2d_t *tsp)
+{
+    size_t n = tsp->dim;
+    uint32_t *ids = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    if (!n)
+        return ids;
+
+    double minx = tsp->nodes[0].x, maxx = minx, miny = tsp->nodes[0].y, maxy = miny;
+    for (size_t i = 1; i < n; i++)
+    {
+        minx = tsp->nodes[i].x < minx ? tsp->nodes[i].x : minx;
+        maxx = tsp->nodes[i].x > maxx ? tsp->nodes[i].x : maxx;
+        miny = tsp->nodes[i].y < miny ? tsp->nodes[i].y : miny;
+        maxy = tsp->nodes[i].y > maxy ? tsp->nodes[i].y : maxy;
+    }
+    // Same scale on both axes, so the curve follows distances
+    double side = maxx - minx > maxy - miny ? maxx - minx : maxy - miny;
+    double scale = side > 0 ? ((1u << HILBERT_BITS) - 1) / side : 0;
+
+    hilbert_key_t *keys = (hilbert_key_t *) malloc(sizeof(hilbert_key_t) * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        keys[i].key = hilbert_index((tsp->nodes[i].x - minx) * scale, (tsp->nodes[i].y - miny) * scale);
+        keys[i].city = i;
+    }
+    qsort(keys, n, sizeof(hilbert_key_t), hilbert_cmp);
+
+    tsp_2d_node_t *nodes = (tsp_2d_node_t *) malloc(sizeof(tsp_2d_node_t) * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        ids[i] = keys[i].city;
+        nodes[i] = tsp->nodes[ids[i]];
+    }
+    free(tsp->nodes);
+    tsp->nodes = nodes;
+    free(keys);
+    return ids;
+}
+
+// Inserts j at squared distance d into a city's nearest, kept sorted, returns the new count
+static int keep_nearest(uint32_t *nb, double *nd, int cnt, int k, uint32_t j, double d)
+{
+    if (cnt == k && d >= nd[cnt - 1])
+        return cnt;
+    int i = cnt < k ? cnt++ : cnt - 1;
+    for (; i > 0 && nd[i - 1] > d; i--)
+    {
+        nb[i] = nb[i - 1];
+        nd[i] = nd[i - 1];
+    }
+    nb[i] = j;
+    nd[i] = d;
+    return cnt;
+}
+
+uint32_t *tsp_2d_nearest(const tsp_2d_t *tsp, int k, int *count, uint32_t *walk)
+{
+    size_t n = tsp->dim;
+    const tsp_2d_node_t *nodes = tsp->nodes;
+
+    double minx = nodes[0].x, maxx = minx, miny = nodes[0].y, maxy = miny;
+    for (size_t i = 1; i < n; i++)
+    {
+        minx = fmin(minx, nodes[i].x);
+        maxx = fmax(maxx, nodes[i].x);
+        miny = fmin(miny, nodes[i].y);
+        maxy = fmax(maxy, nodes[i].y);
+    }
+    int g = (int) ceil(sqrt(n / 2.0));
+    double cw = maxx > minx ? (maxx - minx) / g : 1, ch = maxy > miny ? (maxy - miny) / g : 1;
+
+    // Cities sorted by cell, cells in serpentine order
+    size_t *start = (size_t *) calloc((size_t) g * g + 1, sizeof(size_t));
+    uint32_t *cell = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    uint32_t *sorted = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        int cx = (int) ((nodes[i].x - minx) / cw), cy = (int) ((nodes[i].y - miny) / ch);
+        cx = cx < g ? cx : g - 1;
+        cy = cy < g ? cy : g - 1;
+        cell[i] = cy * g + (cy % 2 ? g - 1 - cx : cx);
+        start[cell[i] + 1]++;
+    }
+    for (int c = 0; c < g * g; c++)
+        start[c + 1] += start[c];
+    size_t *fill = (size_t *) malloc(sizeof(size_t) * g * g);
+    memcpy(fill, start, sizeof(size_t) * g * g);
+    for (size_t i = 0; i < n; i++)
+        sorted[fill[cell[i]]++] = i;
+    free(fill);
+
+    uint32_t *nb = (uint32_t *) malloc(sizeof(uint32_t) * n * k);
+    double *nd = (double *) malloc(sizeof(double) * k);
+    *count = (size_t) k < n - 1 ? k : (int) n - 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        int cnt = 0;
+        int row = cell[i] / g, col = row % 2 ? g - 1 - cell[i] % g : cell[i] % g;
+        for (int r = 0; r <= g; r++)
+        {
+            // Cells at Chebyshev distance r from the city's
+            for (int y = row - r; y <= row + r; y++)
+                for (int x = col - r; x <= col + r; x++)
+                {
+                    if (y < 0 || y >= g || x < 0 || x >= g || (abs(y - row) != r && abs(x - col) != r))
+                        continue;
+                    int c = y * g + (y % 2 ? g - 1 - x : x);
+                    for (size_t s = start[c]; s < start[c + 1]; s++)
+                    {
+                        uint32_t j = sorted[s];
+                        if (j == i)
+                            continue;
+                        double dx = nodes[i].x - nodes[j].x, dy = nodes[i].y - nodes[j].y;
+                        cnt = keep_nearest(nb + i * k, nd, cnt, k, j, dx * dx + dy * dy);
+                    }
+                }
+            // Cities in further rings are at least r cells away
+            double reach = r * fmin(cw, ch);
+            if (cnt == k && nd[k - 1] <= reach * reach)
+                break;
+        }
+    }
+
+    if (walk)
+        memcpy(walk, sorted, sizeof(uint32_t) * n);
+    free(nd);
+    free(sorted);
+    free(cell);
+    free(start);
+    return nb;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 /* Basic (incomplete) parser for TSPLIB (.tsp) files
     http://comopt.ifi.uni-heidelberg.de/software/TSPLIB95/tsp95.pdf
@@ -21,3 +22,20 @@ tsp_2d_t tsp_2d_read_dedup(const char *filename);
 
 void tsp_2d_free(tsp_2d_t tsp);
 
+/* Reads a tour of dim cities into tour, as indices starting at 0. The file is either a TSPLIB
+   tour (.tour) or a binary tour: dim 32-bit indices starting at 0 in the host's byte order, as
+   chromosomes are stored. Returns 0, or -1 if the file can't be read or isn't a permutation of
+   the dim cities */
+int tsp_tour_read(const char *filename, size_t dim, uint32_t *tour);
+
+/* Renumbers the cities in the order of a Hilbert curve over their bounding box, so that cities
+   close to each other are mostly close in memory too. Returns the original index of every city,
+   which the caller must free */
+uint32_t *tsp_2d_hilbert(tsp_2d_t *tsp);
+
+/* Finds the k nearest cities of every city in a grid of about 2 cities per cell. City i's
+   neighbors are at [i * k, i * k + *count), nearest first, count being k or dim - 1 if smaller.
+   If walk is not NULL it receives the cities in a serpentine walk over the cells. The caller
+   must free the result */
+uint32_t *tsp_2d_nearest(const tsp_2d_t *tsp, int k, int *count, uint32_t *walk);
+
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+#include "tune.h"
+#include "genetic.h"
+#include "tsp.h"
+#include "pool.h"
+#include "prof.h"
+#include <dirent.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ISLAND_MAX  8192
+#define NEAR_BEST   0.9     // larger islands win within this fraction of the best throughput
+#define CROSS_COST  20      // crossings take about 1 / CROSS_COST of the run
+
+// Size of the cache of the given level from sysfs, 0 if unknown
+static long cache_size(int level)
+{
+    char path[96], buf[32];
+    for (int i = 0; i < 8; i++)
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+        FILE *fd = fopen(path, "rt");
+        if (!fd)
+            break;
+        int l = fgets(buf, sizeof(buf), fd) ? atoi(buf) : 0;
+        fclose(fd);
+        if (l != level)
+            continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+        if (!(fd = fopen(path, "rt")))
+            break;
+        long size = 0;
+        char unit = 0;
+        if (fgets(buf, sizeof(buf), fd) && sscanf(buf, "%ld%c", &size, &unit) >= 1)
+            size *= unit == 'K' ? 1024 : unit == 'M' ? 1024 * 1024 : 1;
+        fclose(fd);
+        return size;
+    }
+    return 0;
+}
+
+void tune_probe(tune_hw_t *hw)
+{
+    cpu_set_t set;
+    hw->cores = sched_getaffinity(0, sizeof(set), &set) == 0 ? CPU_COUNT(&set) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (hw->cores < 1)
+        hw->cores = 1;
+
+    hw->numa_nodes = 0;
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir)
+    {
+        struct dirent *e;
+        while ((e = readdir(dir)))
+            if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9')
+                hw->numa_nodes++;
+        closedir(dir);
+    }
+    if (hw->numa_nodes < 1)
+        hw->numa_nodes = 1;
+
+    hw->l2 = cache_size(2);
+    hw->l3 = cache_size(3);
+    hw->memory = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+}
+
+struct calib_arg {
+    const tsp_2d_t *tsp;
+    int size, k, mutations, op;
+    double seconds;
+    uint32_t *chunk;
+    ga_solution_t *pop;
+    unsigned long *offspring;   // per island
+};
+
+// Evolves island i from random tours for arg->seconds, counting its offspring
+static void calib_island(size_t i, int worker, void *_arg)
+{
+    struct calib_arg *arg = (struct calib_arg *) _arg;
+    size_t dim = arg->tsp->dim;
+    struct drand48_data rbuf;
+    srand48_r(i + 1, &rbuf);
+    tsp_context_t ctx = { .instance = arg->tsp, .rbuf = &rbuf, .mutations = arg->mutations };
+    tsp_set_local(&ctx);
+
+    // Shuffled tours, ga_init's generator is quadratic in the number of cities
+    ga_solution_t *pop = arg->pop + i * arg->size;
+    uint32_t *chunk = arg->chunk + i * arg->size * dim;
+    for (int s = 0; s < arg->size; s++)
+    {
+        uint32_t *tour = chunk + s * dim;
+        for (uint32_t c = 0; c < dim; c++)
+            tour[c] = c;
+        for (uint32_t c = dim - 1; c > 0; c--)
+        {
+            long r;
+            lrand48_r(&rbuf, &r);
+            uint32_t j = r % (c + 1), aux = tour[c];
+            tour[c] = tour[j];
+            tour[j] = aux;
+        }
+        pop[s] = (ga_solution_t) { .chrom_len = dim, .gene_size = sizeof(uint32_t), .chromosome = tour };
+    }
+
+    ga_ext_t ext = {0};
+    double t0 = prof_seconds();
+    do
+        tsp_engines[arg->op](pop, arg->size, arg->k, arg->mutations, &rbuf, &ext);
+    while (prof_seconds() - t0 < arg->seconds);
+    arg->offspring[i] = ext.offspring;
+    tsp_set_local(NULL);
+}
+
+// Cache an island can keep its solutions in: its core's L2, or its share of the L3 of its NUMA
+// node after the coordinates all islands read, whichever is larger. 0 if the caches are unknown
+static long island_cache(const tune_hw_t *hw, size_t dim)
+{
+    long l3 = hw->l3 - (long) (sizeof(tsp_2d_node_t) * dim);
+    long share = l3 > 0 ? l3 * hw->numa_nodes / hw->cores : 0;
+    return share > hw->l2 ? share : hw->l2;
+}
+
+tune_config_t tune_calibrate(const tsp_2d_t *tsp, const tune_hw_t *hw, int population, int k, int mutations, int op, double seconds, FILE *out)
+{
+    int cores = hw->cores;
+    size_t tour_bytes = sizeof(uint32_t) * tsp->dim;
+    size_t solution_bytes = tour_bytes + sizeof(ga_solution_t);
+    long cache = island_cache(hw, tsp->dim);
+
+    // Candidate sizes, doubling from the smallest giving the population while an island's
+    // solutions fit in its cache and all islands in a quarter of the memory. The smallest is
+    // timed even if it doesn't fit, the population can't shrink
+    int sizes[16], n = 0, size = (population + cores - 1) / cores;
+    if (size < 2)
+        size = 2;
+    for (; (size <= ISLAND_MAX || n == 0) && n < 16; size *= 2)
+        if (n == 0 || ((!cache || (double) size * solution_bytes <= cache) && (double) size * cores * tour_bytes <= hw->memory / 4.0))
+            sizes[n++] = size;
+
+    if (out)
+    {
+        fprintf(out, "Auto configuration: %d cores, %d NUMA node%s, L2 %ld KiB, L3 %ld KiB\n",
+                cores, hw->numa_nodes, hw->numa_nodes > 1 ? "s" : "", hw->l2 / 1024, hw->l3 / 1024);
+        if (cache)
+            fprintf(out, "    %ld KiB of cache per island, %ld solutions\n", cache / 1024, (long) (cache / solution_bytes));
+        fprintf(out, "    island size  offspring/s (%d islands)\n", cores);
+    }
+
+    pool_t *pool = pool_create(cores, 0);
+    unsigned long *offspring = (unsigned long *) malloc(sizeof(unsigned long) * cores);
+    double best_rate = 0, *rates = (double *) malloc(sizeof(double) * n);
+    for (int i = 0; i < n; i++)
+    {
+        struct calib_arg arg = { .tsp = tsp, .size = sizes[i], .k = k, .mutations = mutations, .op = op,
+                                 .seconds = seconds / n, .offspring = offspring };
+        arg.chunk = (uint32_t *) malloc(tour_bytes * sizes[i] * cores);
+        arg.pop = (ga_solution_t *) malloc(sizeof(ga_solution_t) * sizes[i] * cores);
+        pool_run(pool, cores, calib_island, &arg);
+        free(arg.pop);
+        free(arg.chunk);
+
+        unsigned long total = 0;
+        for (int c = 0; c < cores; c++)
+            total += offspring[c];
+        rates[i] = total / arg.seconds;
+        if (rates[i] > best_rate)
+            best_rate = rates[i];
+        if (out)
+            fprintf(out, "    %11d  %.0f\n", sizes[i], rates[i]);
+    }
+    pool_destroy(pool);
+
+    tune_config_t conf = { .islands = cores, .island_size = sizes[0] };
+    for (int i = 0; i < n; i++)
+        if (rates[i] >= NEAR_BEST * best_rate)
+            conf.island_size = sizes[i];
+
+    // A crossing evolves every island's solutions on one thread, which takes as long as one
+    // generation per island
+    conf.interval = cores > 1 ? CROSS_COST * cores : 0;
+    if (conf.interval && conf.interval < 50)
+        conf.interval = 50;
+
+    free(rates);
+    free(offspring);
+    return conf;
+}
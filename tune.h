@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdio.h>
+#include "tsp_parser.h"
+
+/*
+    Automatic configuration of islands from the hardware and a short calibration run
+
+    Every candidate island size is timed with one island per core evolving at once, so shared
+    caches and memory bandwidth are part of the measurement. Candidates start from the smallest
+    size giving the population and double while an island's solutions fit in its cache, its L2
+    or its share of its NUMA node's L3: a short run barely sees the misses of larger islands,
+    which would dominate once their tours spread out. The size with the most offspring per
+    second wins, preferring larger islands when they are within a tenth of the best, since
+    smaller islands are always faster but converge early. Islands cross often enough that the
+    serial crossing generation costs about a twentieth of the run.
+*/
+
+#ifndef TUNE_SECONDS
+#define TUNE_SECONDS 3.0
+#endif
+
+typedef struct {
+    int cores;              // CPUs the process may run on
+    int numa_nodes;
+    long l2, l3;            // cache sizes in bytes, 0 if unknown
+    long memory;            // physical memory in bytes
+} tune_hw_t;
+
+typedef struct {
+    int islands;
+    int island_size;
+    int interval;           // generations between island crossings
+} tune_config_t;
+
+void tune_probe(tune_hw_t *hw);
+
+// Times islands of growing sizes on tsp for about seconds in total, with tournament size k, the
+// mutation rate and the mutation operator op, and returns the fastest configuration for hw with
+// at least population solutions in total. The hardware and the measurements are printed to out
+// unless it is NULL
+tune_config_t tune_calibrate(const tsp_2d_t *tsp, const tune_hw_t *hw, int population, int k, int mutations, int op, double seconds, FILE *out);